@@ -0,0 +1,44 @@
+#include "Arena.h"
+#include <new>
+
+Arena::Arena(size_t initialBytes) : capacity(initialBytes) {
+	block = static_cast<char*>(::operator new(capacity));
+}
+
+Arena::~Arena() {
+	releaseOverflow();
+	::operator delete(block);
+}
+
+void Arena::reset() {
+	if (!overflow.empty()) {
+		// Grow so that a request this size fits in the block next time
+		size_t needed = used + overflowBytes;
+		releaseOverflow();
+		while (capacity < needed) capacity *= 2;
+		::operator delete(block);
+		block = static_cast<char*>(::operator new(capacity));
+	}
+	used = 0;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment) {
+	// The block itself is aligned for any fundamental type
+	size_t start = (used + alignment - 1) & ~(alignment - 1);
+	if (alignment <= alignof(max_align_t) && start + bytes <= capacity) {
+		used = start + bytes;
+		return block + start;
+	}
+	void* extra = ::operator new(bytes, align_val_t(alignment));
+	overflow.emplace_back(extra, alignment);
+	overflowBytes += bytes + alignment;
+	return extra;
+}
+
+void Arena::releaseOverflow() {
+	for (auto& allocation : overflow) {
+		::operator delete(allocation.first, align_val_t(allocation.second));
+	}
+	overflow.clear();
+	overflowBytes = 0;
+}
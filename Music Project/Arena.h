@@ -0,0 +1,36 @@
+#pragma once
+#include <cstddef>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Monotonic scratch memory for one generation request. Allocations bump a pointer through one block and
+// deallocation does nothing; reset() makes the whole block free again in O(1). If a request outgrows the block,
+// the extra comes from the global allocator and the next reset() grows the block to fit, so after a warm-up
+// request of the same size generation makes no global allocations at all.
+// Use through std::pmr containers, e.g. pmr::vector<int> notes(&arena). Not thread-safe, one per thread.
+class Arena : public pmr::memory_resource {
+public:
+	explicit Arena(size_t initialBytes = 16 * 1024);
+	~Arena();
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Everything allocated since the last reset becomes invalid
+	void reset();
+	size_t getCapacity() const { return capacity; }
+	size_t getUsed() const { return used + overflowBytes; }
+
+private:
+	char* block;
+	size_t capacity;
+	size_t used = 0;
+	vector<pair<void*, size_t>> overflow;	// Allocations that didn't fit, with their alignment
+	size_t overflowBytes = 0;
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const pmr::memory_resource& other) const noexcept override { return this == &other; }
+	void releaseOverflow();
+};
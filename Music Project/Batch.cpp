@@ -0,0 +1,234 @@
+#include "Batch.h"
+#include "Arena.h"
+#include "WritePhrase.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+
+// Jobs sharing one Xorshift32Lanes, each lane keeps up to about one job's worth of draws queued
+const size_t LANES_PER_GROUP = 64;
+
+void generateJob(const GenerationJob& job, RngMode mode, ExportToFile& exporter, Xorshift32* rng, RenderedPhrase* rendered) {
+	// Each thread reuses one arena for the scratch memory of every job it generates
+	static thread_local Arena scratch;
+	scratch.reset();
+
+	Xorshift32 streamRng(job.seed);
+	if (rng == nullptr) rng = &streamRng;
+	Xorshift32 lowerRng = Xorshift32::counterBased(job.seed, 0, 0);
+	Xorshift32 upperRng = Xorshift32::counterBased(job.seed, 0, 1);
+
+	WritePhrase phrase(job.key, job.measures, job.species, job.beats, *rng, &scratch);
+	phrase.setEngine(job.engine);
+	phrase.setBeamOptions(job.beam);
+	phrase.setLowerVoice(job.lowerVoice, job.library);
+	phrase.setSpeciesTwo(job.speciesTwo);
+	phrase.setVoiceCount(job.voices);
+	if (mode == Rng_Counter) {
+		phrase.setVoiceRngs(lowerRng, upperRng);
+	}
+	phrase.writeThePhrase();
+	if (rendered != nullptr) {
+		rendered->upperVoiceI.assign(phrase.getUpperVoiceI().begin(), phrase.getUpperVoiceI().end());
+		rendered->lowerVoiceI.assign(phrase.getLowerVoiceI().begin(), phrase.getLowerVoiceI().end());
+		const pmr::vector<int>& middle = phrase.getMiddleVoicesI();
+		for (size_t i = 0; i < middle.size(); i += rendered->lowerVoiceI.size()) {
+			rendered->middleVoicesI.emplace_back(middle.begin() + i, middle.begin() + i + rendered->lowerVoiceI.size());
+		}
+	}
+
+	exporter.addPhrase(phrase.takePhrase());
+	exporter.setComposer("Comparison Test");
+	exporter.setTitle("Comparison Test");
+}
+
+string renderJob(const GenerationJob& job, RngMode mode, Xorshift32* rng) {
+	ExportToFile exporter;
+	generateJob(job, mode, exporter, rng);
+	ostringstream output;
+	exporter.WriteOutput(output);
+	return output.str();
+}
+
+RenderedPhrase renderPhrase(const GenerationJob& job, RngMode mode, Xorshift32* rng) {
+	RenderedPhrase rendered;
+	ExportToFile exporter;
+	generateJob(job, mode, exporter, rng, &rendered);
+	ostringstream output;
+	exporter.WriteOutput(output);
+	rendered.output = output.str();
+	return rendered;
+}
+
+// Runs jobs [begin, end) in order on the calling thread, sharing one Xorshift32Lanes. On a pool worker a beam search
+// runs on that worker alone, rather than every job starting threads of its own
+static void runGroup(const vector<GenerationJob>& jobs, size_t begin, size_t end, RngMode mode, bool onPool, const function<void(JobResult&)>& finish) {
+	vector<uint32_t> seeds;
+	for (size_t i = begin; i < end; i++) {
+		seeds.push_back(jobs.at(i).seed);
+	}
+	Xorshift32Lanes lanes(seeds);
+
+	for (size_t i = begin; i < end; i++) {
+		JobResult result;
+		result.job = jobs.at(i);
+		result.index = static_cast<int>(i);
+		if (onPool) result.job.beam.threads = 1;
+		Xorshift32 rng = Xorshift32::fromLane(lanes, static_cast<int>(i - begin));
+		auto start = chrono::steady_clock::now();
+		try {
+			result.output = renderJob(result.job, mode, &rng);
+		}
+		catch (exception& exception) {
+			result.error = exception.what();
+		}
+		result.milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		finish(result);
+	}
+}
+
+void runBatch(const vector<GenerationJob>& jobs, RngMode mode, const function<void(const JobResult&)>& emit, int threads) {
+	if (threads == 1) {
+		for (size_t group = 0; group < jobs.size(); group += LANES_PER_GROUP) {
+			runGroup(jobs, group, min(jobs.size(), group + LANES_PER_GROUP), mode, false, emit);
+		}
+		return;
+	}
+
+	// Finished results wait here until every job before them has been emitted
+	vector<JobResult> results(jobs.size());
+	vector<bool> finished(jobs.size(), false);
+	mutex finishedLock;
+	condition_variable finishedSignal;
+
+	// Declared after the results so its destructor drains the tasks before they go away
+	WorkStealingPool pool(threads);
+
+	// Enough groups that every worker has several to start with and some to steal, but no wider than one set of lanes
+	size_t groups = max((jobs.size() + LANES_PER_GROUP - 1) / LANES_PER_GROUP, static_cast<size_t>(pool.size()) * 4);
+	size_t groupSize = max<size_t>(1, (jobs.size() + groups - 1) / groups);
+	for (size_t group = 0; group < jobs.size(); group += groupSize) {
+		size_t groupEnd = min(jobs.size(), group + groupSize);
+		pool.submit([&, group, groupEnd] {
+			runGroup(jobs, group, groupEnd, mode, true, [&](JobResult& result) {
+				int index = result.index;
+				results.at(index) = move(result);
+				lock_guard<mutex> guard(finishedLock);
+				finished.at(index) = true;
+				finishedSignal.notify_all();
+			});
+		});
+	}
+
+	for (size_t i = 0; i < jobs.size(); i++) {
+		{
+			unique_lock<mutex> guard(finishedLock);
+			finishedSignal.wait(guard, [&] { return static_cast<bool>(finished.at(i)); });
+		}
+		emit(results.at(i));
+		results.at(i) = JobResult();	// Release the text once it's written
+	}
+	pool.wait();
+}
+
+vector<string> parseList(const string& list) {
+	vector<string> items;
+	stringstream stream(list);
+	string item;
+	while (getline(stream, item, ',')) {
+		if (!item.empty()) items.push_back(item);
+	}
+	if (items.empty()) throw runtime_error("Empty list: \"" + list + "\"");
+	return items;
+}
+
+vector<uint32_t> parseSeeds(const string& list) {
+	vector<uint32_t> seeds;
+	for (const auto& item : parseList(list)) {
+		// A leading '-' belongs to the number, a later one separates a range
+		size_t dash = item.find('-', 1);
+		try {
+			if (dash == string::npos) {
+				seeds.push_back(static_cast<uint32_t>(stoll(item)));
+				continue;
+			}
+			long long first = stoll(item.substr(0, dash));
+			long long last = stoll(item.substr(dash + 1));
+			if (last < first) throw runtime_error("Descending range: " + item);
+			for (long long seed = first; seed <= last; seed++) {
+				seeds.push_back(static_cast<uint32_t>(seed));
+			}
+		}
+		catch (logic_error&) {	// stoll's invalid_argument and out_of_range
+			throw runtime_error("Invalid number or range: " + item);
+		}
+	}
+	return seeds;
+}
+
+vector<int> parseInts(const string& list) {
+	vector<int> values;
+	for (auto value : parseSeeds(list)) {
+		values.push_back(static_cast<int>(value));
+	}
+	return values;
+}
+
+vector<GenerationJob> expandJobs(const vector<uint32_t>& seeds, const vector<string>& keys, const vector<int>& species,
+	const vector<int>& measures, const vector<int>& beats) {
+	vector<GenerationJob> jobs;
+	for (auto speciesType : species) {
+		for (const auto& key : keys) {
+			for (auto measureCount : measures) {
+				for (auto beatCount : beats) {
+					for (auto seed : seeds) {
+						GenerationJob job;
+						job.seed = seed;
+						job.key = key;
+						job.species = speciesType;
+						job.measures = measureCount;
+						job.beats = beatCount;
+						jobs.push_back(job);
+					}
+				}
+			}
+		}
+	}
+	return jobs;
+}
+
+vector<GenerationJob> readJobFile(const string& fileName) {
+	ifstream jobFile(fileName);
+	if (!jobFile) throw runtime_error("Couldn't open job file: " + fileName);
+
+	vector<GenerationJob> jobs;
+	string line;
+	int lineNumber = 0;
+	while (getline(jobFile, line)) {
+		lineNumber++;
+		stringstream fields(line);
+		string seeds, keys, species, measures, beats, extra;
+		if (!(fields >> seeds) || seeds.at(0) == '#') continue;
+		if (!(fields >> keys >> species >> measures >> beats) || (fields >> extra)) {
+			throw runtime_error(fileName + ":" + to_string(lineNumber) + ": expected \"seeds keys species measures beats\"");
+		}
+		vector<GenerationJob> lineJobs = expandJobs(parseSeeds(seeds), parseList(keys), parseInts(species), parseInts(measures), parseInts(beats));
+		jobs.insert(jobs.end(), lineJobs.begin(), lineJobs.end());
+	}
+	return jobs;
+}
+
+string describeJob(const GenerationJob& job) {
+	return "seed=" + to_string(job.seed) + " key=" + job.key + " species=" + to_string(job.species)
+		+ " measures=" + to_string(job.measures) + " beats=" + to_string(job.beats)
+		+ (job.engine == Engine_Uniform ? " engine=" + engineName(job.engine) : "")
+		+ (job.engine == Engine_Beam ? " engine=" + engineName(job.engine) + " width=" + to_string(job.beam.width) : "")
+		+ (job.lowerVoice == Lower_Cantus ? string(" lower=") + (job.library != nullptr ? "library" : "cantus") : "")
+		+ (job.speciesTwo == Two_Derived ? " two=" + speciesTwoName(job.speciesTwo) : "")
+		+ (job.voices != 2 ? " voices=" + to_string(job.voices) : "");
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include "ExportToFile.h"
+#include "WritePhrase.h"
+#include "xorshift32.h"
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// How a job's voices draw their random numbers, see --rng in Main.cpp
+enum RngMode {
+	Rng_Stream,		// One Xorshift32 stream seeded with the job's seed (the default, matches the TS port)
+	Rng_Counter		// Xorshift32::counterBased per voice, lower voice = 0, upper voice = 1
+};
+
+// Everything needed to generate one phrase, the same fields as the single phrase CLI
+struct GenerationJob {
+	uint32_t seed = 0;
+	string key = "C";
+	int species = 1;
+	int measures = 4;
+	int beats = 4;
+	SpeciesOneEngine engine = Engine_Table;	// Only used by species 1, and by species 0 for Engine_Beam
+	BeamOptions beam;						// Only used by Engine_Beam
+	LowerVoiceSource lowerVoice = Lower_Walk;	// Only used by species 1 to 5, not by Two_Derived or more voices
+	SpeciesTwoEngine speciesTwo = Two_Rules;	// Only used by species 2
+	int voices = 2;							// Counting the lower voice, more than two only for species 1
+	const CantusFirmusLibrary* library = nullptr;	// Not owned, Lower_Cantus and more voices pick from it when it has the length
+};
+
+struct JobResult {
+	GenerationJob job;
+	int index = 0;				// Position of the job in the batch
+	string output;				// LilyPond text, what the single phrase CLI would write to its --output file
+	string error;				// Set instead of output if generation threw
+	double milliseconds = 0;	// Generation and rendering time
+};
+
+// A generated job, the LilyPond text along with the scale degrees it was written from
+struct RenderedPhrase {
+	string output;
+	vector<int> upperVoiceI;
+	vector<vector<int>> middleVoicesI;	// Inner voices top first, none for two voices
+	vector<int> lowerVoiceI;
+};
+
+/**
+ * @brief
+ * Writes the phrase for a job and adds it to the exporter, with the title and composer the single phrase CLI uses
+ *
+ * @param rng
+ * Stream to draw from in Rng_Stream mode, if null a fresh Xorshift32 seeded with job.seed is used
+ *
+ * @param rendered
+ * If given, receives the phrase's scale degrees
+ */
+void generateJob(const GenerationJob& job, RngMode mode, ExportToFile& exporter, Xorshift32* rng = nullptr, RenderedPhrase* rendered = nullptr);
+
+// Generates a job and returns the LilyPond text, without touching the file system
+string renderJob(const GenerationJob& job, RngMode mode, Xorshift32* rng = nullptr);
+// Same, keeping the scale degrees too
+RenderedPhrase renderPhrase(const GenerationJob& job, RngMode mode, Xorshift32* rng = nullptr);
+
+/**
+ * @brief
+ * Generates every job in one process, handing each result to emit in submission order as soon as it is done
+ *
+ * @post
+ * In Rng_Stream mode jobs draw from Xorshift32Lanes lanes seeded with their own seeds, so every job's output is
+ * identical to running the single phrase CLI with the same parameters, whatever the thread count
+ *
+ * @param threads
+ * Worker threads of a WorkStealingPool, 0 for one per hardware thread and 1 to run everything on the calling thread.
+ * With more than one, beam searches ignore BeamOptions::threads and run on their job's worker. emit is always called on
+ * the calling thread
+ */
+void runBatch(const vector<GenerationJob>& jobs, RngMode mode, const function<void(const JobResult&)>& emit, int threads = 1);
+
+// Parsing for the batch CLI -- lists are comma separated, and numbers may be ranges like 1-100
+vector<string> parseList(const string& list);
+vector<uint32_t> parseSeeds(const string& list);
+vector<int> parseInts(const string& list);
+
+/**
+ * @brief
+ * Every combination of the given parameter lists, seeds varying fastest
+ */
+vector<GenerationJob> expandJobs(const vector<uint32_t>& seeds, const vector<string>& keys, const vector<int>& species,
+	const vector<int>& measures, const vector<int>& beats);
+
+/**
+ * @brief
+ * Reads a job file. Each line holds "seeds keys species measures beats", each field a list as on the command line,
+ * and expands to every combination. Blank lines and lines starting with # are skipped
+ */
+vector<GenerationJob> readJobFile(const string& fileName);
+
+// One line describing a job, used for the multiplexed output and the timing report. The engine is only named when
+// it changes the output
+string describeJob(const GenerationJob& job);
@@ -0,0 +1,234 @@
+#include "BeamSearch.h"
+#include "SpeciesRules.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <stdexcept>
+
+const int MAX_CANDIDATES = OPTION_COUNT;	// Notes a line can go on to, at most
+const int PARALLEL_LINES = 256;				// Narrower beams are expanded on the calling thread
+const size_t MIN_PRUNE_LINES = 1 << 16;		// Shorter trails are never pruned
+
+// Penalty for the move from before to note in the same voice
+static double melodicPenalty(int before, int note) {
+	int leap = abs(note - before);
+	if (leap == 0) return 2;	// Repeated note
+	// Steps are free, leaps cost their size and anything past a sixth a lot more
+	return leap - 1 + (leap > 5 ? 4 : 0);
+}
+
+// The upper voice over a fixed lower voice, the notes writeUpperVoiceOne could write
+class FirstSpeciesProblem {
+public:
+	explicit FirstSpeciesProblem(const pmr::vector<int>& lower) : lower(lower) {}
+	int length() const { return static_cast<int>(lower.size()); }
+
+	int candidates(int position, int noteBefore, int* notes) const {
+		if (position == 0) {
+			notes[0] = 5;
+			notes[1] = 8;
+			return 2;
+		}
+		// Nothing in FirstSpeciesRules looks further back than the note before
+		uint32_t options = FirstSpeciesRules::allowed({ lower[position], noteBefore, lower[position - 1], 0, position });
+		int cadence = position == length() - 2 ? 7 : position == length() - 1 ? 8 : 0;
+		if (cadence != 0) {
+			int offset = cadence - lower[position];
+			options &= offset >= 1 && offset <= OPTION_COUNT ? 1u << (offset - 1) : 0;
+		}
+		int count = 0;
+		for (int offset = 1; offset <= OPTION_COUNT; offset++) {
+			if (options & (1u << (offset - 1))) notes[count++] = lower[position] + offset;
+		}
+		return count;
+	}
+
+	double stepScore(int position, int noteBefore, int note) const {
+		int upperMotion = note - noteBefore;
+		int lowerMotion = lower[position] - lower[position - 1];
+		double motion = upperMotion * lowerMotion < 0 ? -1 : upperMotion * lowerMotion > 0 ? 0.5 : 0;
+		return melodicPenalty(noteBefore, note) + motion;
+	}
+
+private:
+	const pmr::vector<int>& lower;
+};
+
+// The imitative lower voice: 1, free notes, then 2, 1. A free note repeats the one before or moves up a third or a
+// fifth, or down by one of SpeciesOne's pickImitativeDown() moves, and turns back at the same range limits
+class ImitativeProblem {
+public:
+	// As SpeciesOne::writeImitativeLowerVoice, a phrase too short for free notes is still 1, 2, 1
+	explicit ImitativeProblem(int length) : notes(max(length, 3)) {}
+	int length() const { return notes; }
+
+	int candidates(int position, int noteBefore, int* next) const {
+		if (position == 0 || position == notes - 1) {
+			next[0] = 1;
+			return 1;
+		}
+		if (position == notes - 2) {
+			next[0] = 2;
+			return 1;
+		}
+		int count = 0;
+		if (noteBefore <= 5) {
+			for (int move : { 0, 2, 4 }) next[count++] = noteBefore + move;
+		}
+		if (noteBefore >= -4) {
+			for (int move : { 2, 3, 5 }) next[count++] = noteBefore - move;
+		}
+		return count;
+	}
+
+	double stepScore(int, int noteBefore, int note) const { return melodicPenalty(noteBefore, note); }
+
+private:
+	int notes;
+};
+
+BeamSearch::BeamSearch(const BeamOptions& options, pmr::memory_resource* scratch) : options(options), scratch(scratch) {
+	if (options.width < 1) throw runtime_error("The beam width must be at least 1");
+	if (options.threads != 1) pool = make_unique<WorkStealingPool>(options.threads);
+}
+
+BeamSearch::~BeamSearch() = default;
+
+void BeamSearch::writeFirstSpecies(const pmr::vector<int>& lower, Xorshift32& rng, pmr::vector<int>& upper) {
+	if (lower.size() < 3) throw runtime_error("The lower voice is too short for a cadence");
+	search(FirstSpeciesProblem(lower), rng, upper);
+}
+
+void BeamSearch::writeImitativeLower(int length, Xorshift32& rng, pmr::vector<int>& lower) {
+	search(ImitativeProblem(length), rng, lower);
+}
+
+template <class Problem>
+void BeamSearch::expand(const Problem& problem, int position, const pmr::vector<Line>& beam, int offset, int begin, int end, Line* children) const {
+	// Every line has MAX_CANDIDATES slots, so lines can be expanded in any order and on any thread. offset is the
+	// trail index of beam[0]
+	for (int i = begin; i < end; i++, children += MAX_CANDIDATES) {
+		const Line& line = beam[i];
+		int notes[MAX_CANDIDATES];
+		int count = problem.candidates(position, line.note, notes);
+		for (int slot = 0; slot < MAX_CANDIDATES; slot++) {
+			Line& child = children[slot];
+			if (slot >= count) {
+				child.parent = -1;
+				continue;
+			}
+			child.parent = offset + i;
+			child.note = notes[slot];
+			child.score = line.score + problem.stepScore(position, line.note, child.note);
+			child.climax = max(line.climax, child.note);
+			child.climaxCount = child.note > line.climax ? 1 : line.climaxCount + (child.note == line.climax);
+			child.hash = Xorshift32::deriveSeed(line.hash, static_cast<uint32_t>(child.note));
+		}
+	}
+}
+
+void BeamSearch::prune(pmr::vector<Back>& trail, pmr::vector<Line>& beam, pmr::vector<int>& renumbered) const {
+	// The scratch memory may never be given back, so one buffer is reused for every prune
+	if (renumbered.capacity() < trail.size()) renumbered.reserve(2 * trail.size());
+	renumbered.assign(trail.size(), -1);
+	for (const Line& line : beam) {
+		for (int i = line.parent; i >= 0 && renumbered[i] < 0; i = trail[i].parent) renumbered[i] = 0;
+	}
+	// Parents come before their children, so the kept lines move down in place
+	int kept = 0;
+	for (size_t i = 0; i < trail.size(); i++) {
+		if (renumbered[i] < 0) continue;
+		renumbered[i] = kept;
+		int parent = trail[i].parent;
+		trail[kept++] = { parent >= 0 ? renumbered[parent] : -1, trail[i].note };
+	}
+	trail.resize(kept);
+	for (Line& line : beam) {
+		if (line.parent >= 0) line.parent = renumbered[line.parent];
+	}
+}
+
+template <class Problem>
+void BeamSearch::search(const Problem& problem, Xorshift32& rng, pmr::vector<int>& out) {
+	auto start = chrono::steady_clock::now();
+	int length = problem.length();
+	outOfTime = false;
+
+	rng.setPosition(0);
+	uint32_t key = static_cast<uint32_t>(rng.nextFloat() * 4294967296.0);
+
+	// The lines of the current step, and a back-pointer for every line kept at every step so far
+	pmr::vector<Line> beam(scratch);
+	pmr::vector<Back> trail(scratch);
+	pmr::vector<int> renumbered(scratch);
+	size_t pruneAt = MIN_PRUNE_LINES;
+	int notes[MAX_CANDIDATES];
+	int count = problem.candidates(0, 0, notes);
+	for (int i = 0; i < count; i++) {
+		beam.push_back({ -1, notes[i], notes[i], 1, 0, Xorshift32::deriveSeed(key, static_cast<uint32_t>(notes[i])) });
+	}
+	auto better = [](const Line& a, const Line& b) {
+		if (a.total() != b.total()) return a.total() < b.total();
+		if (a.hash != b.hash) return a.hash < b.hash;
+		return a.parent != b.parent ? a.parent < b.parent : a.note < b.note;
+	};
+	sort(beam.begin(), beam.end(), better);
+	int width = options.width;
+
+	pmr::vector<Line> children(scratch);
+	for (int position = 1; position < length; position++) {
+		if (options.timeBudgetMs > 0 && !outOfTime
+			&& chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() > options.timeBudgetMs) {
+			outOfTime = true;
+			width = 1;
+		}
+
+		// Most lines die out within a few steps, so the trail is pruned whenever it doubles and stays about as long as
+		// the lines still alive rather than width * length
+		if (trail.size() >= pruneAt) {
+			prune(trail, beam, renumbered);
+			pruneAt = max(2 * trail.size(), MIN_PRUNE_LINES);
+		}
+
+		// The beam's lines go on the trail before they are expanded
+		int first = static_cast<int>(trail.size());
+		for (const Line& line : beam) {
+			trail.push_back({ line.parent, line.note });
+		}
+		int lines = static_cast<int>(beam.size());
+		children.resize(static_cast<size_t>(lines) * MAX_CANDIDATES);
+		if (pool && lines >= PARALLEL_LINES) {
+			int chunks = pool->size() * 4;
+			int chunkSize = (lines + chunks - 1) / chunks;
+			for (int begin = 0; begin < lines; begin += chunkSize) {
+				int chunkEnd = min(begin + chunkSize, lines);
+				Line* slots = children.data() + static_cast<size_t>(begin) * MAX_CANDIDATES;
+				pool->submit([this, &problem, position, &beam, first, begin, chunkEnd, slots] {
+					expand(problem, position, beam, first, begin, chunkEnd, slots);
+				});
+			}
+			pool->wait();
+		}
+		else {
+			expand(problem, position, beam, first, 0, lines, children.data());
+		}
+
+		children.erase(remove_if(children.begin(), children.end(), [](const Line& line) { return line.parent < 0; }), children.end());
+		if (children.empty()) throw runtime_error("The beam search found no line that reaches the cadence");
+		if (static_cast<int>(children.size()) > width) {
+			nth_element(children.begin(), children.begin() + width, children.end(), better);
+			children.resize(width);
+		}
+		sort(children.begin(), children.end(), better);
+		beam.swap(children);
+	}
+
+	// The best line is the first of the last step, read back to front
+	bestScore = beam[0].total();
+	size_t begin = out.size();
+	out.push_back(beam[0].note);
+	for (int i = beam[0].parent; i >= 0; i = trail[i].parent) {
+		out.push_back(trail[i].note);
+	}
+	reverse(out.begin() + begin, out.end());
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include "WorkStealingPool.h"
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+struct BeamOptions {
+	int width = 64;				// Partial lines kept after each note
+	double timeBudgetMs = 0;	// After this long the rest of the line is finished greedily, 0 for no limit
+	int threads = 1;			// Threads expanding each step of a wide beam, 0 for one per hardware thread
+};
+
+/**
+ * @brief
+ * Best of many voices instead of the first the rules allow: a beam search that writes a line note by note, keeping
+ * the options.width partial lines with the lowest penalty after each note.
+ *
+ * The penalty is a melodic quality score kept up to date one note at a time, so extending a line costs the same
+ * however long it is: leaps (more for anything past a sixth), repeated notes, motion similar to the lower voice
+ * (contrary motion scores below zero), and 3 for every note that reaches the line's highest note again, so lines
+ * with a single climax win. Lines of equal score are ordered by a hash of their notes seeded from one draw of the
+ * rng, so the same seed always writes the same line, on any number of threads
+ */
+class BeamSearch {
+public:
+	explicit BeamSearch(const BeamOptions& options, pmr::memory_resource* scratch = pmr::get_default_resource());
+	~BeamSearch();
+
+	// Appends an upper voice over lower in place of writeUpperVoiceOne's: 5 or 8, FirstSpeciesRules throughout, then
+	// 7, 8. Throws runtime_error if no line reaches the cadence
+	void writeFirstSpecies(const pmr::vector<int>& lower, Xorshift32& rng, pmr::vector<int>& upper);
+	// Appends a lower voice for imitative counterpoint, the same moves and range SpeciesOne::writeImitativeLowerVoice
+	// picks from at random
+	void writeImitativeLower(int length, Xorshift32& rng, pmr::vector<int>& lower);
+
+	// Penalty of the last line written
+	double getBestScore() const { return bestScore; }
+	// Whether the last line ran past options.timeBudgetMs and was finished greedily
+	bool ranOutOfTime() const { return outOfTime; }
+
+private:
+	struct Line {
+		int parent;			// Index in the trail of the line it extends
+		int note;
+		int climax;			// Highest note so far
+		int climaxCount;	// Times it has been reached
+		double score;		// Penalty without the climax's, which climaxCount gives
+		uint32_t hash;		// Of every note so far, orders lines of equal score
+		double total() const { return score + 3.0 * (climaxCount - 1); }
+	};
+	// What's left of a line once it falls out of the beam, enough to read the best line back at the end
+	struct Back {
+		int parent;
+		int note;
+	};
+
+	BeamOptions options;
+	pmr::memory_resource* scratch;
+	unique_ptr<WorkStealingPool> pool;	// Only made when threads != 1
+	double bestScore = 0;
+	bool outOfTime = false;
+
+	// Drops the trail's lines that no line in the beam descends from, renumbering the rest in the same order.
+	// renumbered is working space
+	void prune(pmr::vector<Back>& trail, pmr::vector<Line>& beam, pmr::vector<int>& renumbered) const;
+	template <class Problem>
+	void search(const Problem& problem, Xorshift32& rng, pmr::vector<int>& out);
+	template <class Problem>
+	void expand(const Problem& problem, int position, const pmr::vector<Line>& beam, int offset, int begin, int end, Line* children) const;
+};
@@ -0,0 +1,163 @@
+#include "CantusFirmus.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+
+// Melodic moves in scale steps, steps favoured over leaps
+const int MOVE_COUNT = 10;
+const int MOVES[MOVE_COUNT] = { 1, -1, 2, -2, 3, -3, 4, -4, 7, -7 };
+const double MOVE_WEIGHTS[MOVE_COUNT] = { 6, 6, 3, 3, 2, 2, 1, 1, 1, 1 };
+
+// 1-7 for any scale degree, so 0 is 7 (ti) and 11 is 4 (fa)
+static int degreeClass(int note) {
+	return ((note - 1) % 7 + 7) % 7 + 1;
+}
+
+// What's wrong with moving from before to note after lastMove (0 for the first move), or null if nothing is
+static const char* moveProblem(int before, int note, int lastMove) {
+	int move = note - before;
+	int size = abs(move);
+	if (size == 0) return "repeats a note";
+	if (size > 4 && size != 7) return "leaps a sixth, a seventh or past an octave";
+	if ((size == 3 || size == 4) && min(degreeClass(before), degreeClass(note)) == 4 && max(degreeClass(before), degreeClass(note)) == 7) {
+		return "leaps a tritone";
+	}
+	if (abs(lastMove) >= 3 && !(size == 1 && move * lastMove < 0)) return "doesn't step back after a leap";
+	if (abs(lastMove) >= 2 && size >= 2 && move * lastMove > 0) return "leaps twice in the same direction";
+	return nullptr;
+}
+
+CantusFirmus::CantusFirmus(Xorshift32& rng, int length, pmr::memory_resource* scratch) : notes(scratch), lows(scratch), highs(scratch) {
+	if (length <= 3) {
+		// No room for anything but the cadence, as GenerateLowerVoice
+		for (int note : { 1, 2, 1 }) push(note);
+		return;
+	}
+	notes.reserve(length);
+	lows.reserve(length);
+	highs.reserve(length);
+
+	// The climax goes in the middle third of the free notes, no higher than thirds could reach on either side of it
+	int earliest = max(1, (length - 1) / 3);
+	int latest = max(earliest, min(length - 3, 2 * (length - 1) / 3));
+	for (int attempt = 0; attempt < PLAN_ATTEMPTS; attempt++) {
+		rng.setPosition(0, attempt * 2);
+		int climaxAt = earliest + rng.nextInt(latest - earliest + 1);
+		int highest = min({ HIGHEST, 1 + 2 * climaxAt, 2 + 2 * (length - 2 - climaxAt) });
+		int climax = 3 + rng.nextInt(highest - 2);
+		if (tryPlan(rng, length, attempt, climax, climaxAt)) return;
+	}
+	throw runtime_error("No cantus firmus of " + to_string(length) + " notes found");
+}
+
+bool CantusFirmus::tryPlan(Xorshift32& rng, int length, int attempt, int climax, int climaxAt) {
+	notes.clear();
+	lows.clear();
+	highs.clear();
+	push(1);
+
+	// Moves given up on at each position, one bit per MOVES entry
+	pmr::vector<uint32_t> tried(length, 0, notes.get_allocator());
+	int undone = 0;
+	int i = 1;
+	while (i < length) {
+		if (i >= length - 2) {
+			// The cadence, 2 then 1
+			int note = i == length - 2 ? 2 : 1;
+			if (allowed(note, length, climax, climaxAt)) {
+				push(note);
+				i++;
+				continue;
+			}
+		}
+		else {
+			uint32_t options = 0;
+			double total = 0;
+			for (int move = 0; move < MOVE_COUNT; move++) {
+				if (!(tried[i] & (1u << move)) && allowed(notes.back() + MOVES[move], length, climax, climaxAt)) {
+					options |= 1u << move;
+					total += MOVE_WEIGHTS[move];
+				}
+			}
+			if (options != 0) {
+				// A retry at this position takes the draw after the ones already used here
+				int triedCount = 0;
+				for (uint32_t bits = tried[i]; bits; bits &= bits - 1) triedCount++;
+				rng.setPosition(i, static_cast<uint32_t>(attempt * (MOVE_COUNT + 1) + triedCount));
+				double target = rng.nextFloat() * total;
+				int chosen = -1;
+				for (int move = 0; move < MOVE_COUNT; move++) {
+					if (!(options & (1u << move))) continue;
+					chosen = move;	// The last option catches rounding at the top end
+					if (target < MOVE_WEIGHTS[move]) break;
+					target -= MOVE_WEIGHTS[move];
+				}
+				push(notes.back() + MOVES[chosen]);
+				i++;
+				continue;
+			}
+		}
+
+		// Dead end: undo notes back to the last free one and rule out the move that led to it
+		if (++undone > STEP_BUDGET) return false;
+		tried[i] = 0;
+		i--;
+		while (i >= length - 2) {	// The cadence notes have nothing else to try
+			pop();
+			i--;
+		}
+		if (i == 0) return false;
+		int move = notes[i] - notes[i - 1];
+		for (int m = 0; m < MOVE_COUNT; m++) {
+			if (MOVES[m] == move) tried[i] |= 1u << m;
+		}
+		pop();
+	}
+	return true;
+}
+
+bool CantusFirmus::allowed(int note, int length, int climax, int climaxAt) const {
+	int position = static_cast<int>(notes.size());
+	if (note < LOWEST || note > HIGHEST) return false;
+	if (max(highs.back(), note) - min(lows.back(), note) > MAX_RANGE) return false;
+	int lastMove = position >= 2 ? notes[position - 1] - notes[position - 2] : 0;
+	if (moveProblem(notes.back(), note, lastMove) != nullptr) return false;
+
+	// Only the planned note reaches the climax, and the line can still get to it and then to the cadence
+	if (position == climaxAt) return note == climax;
+	if (note >= climax) return false;
+	if (position < climaxAt) return climax - note <= 7 * (climaxAt - position);
+	return position >= length - 2 || abs(note - 2) <= 7 * (length - 2 - position);
+}
+
+void CantusFirmus::push(int note) {
+	lows.push_back(lows.empty() ? note : min(lows.back(), note));
+	highs.push_back(highs.empty() ? note : max(highs.back(), note));
+	notes.push_back(note);
+}
+
+void CantusFirmus::pop() {
+	notes.pop_back();
+	lows.pop_back();
+	highs.pop_back();
+}
+
+string CantusFirmus::findProblem(const pmr::vector<int>& line) {
+	int length = static_cast<int>(line.size());
+	if (length < 3) return "is shorter than three notes";
+	if (line.front() != 1) return "doesn't start on the tonic";
+	if (line.back() != 1) return "doesn't end on the tonic";
+	if (line[length - 2] != 2) return "doesn't step down to the final";
+
+	int lowest = *min_element(line.begin(), line.end());
+	int highest = *max_element(line.begin(), line.end());
+	if (lowest < LOWEST || highest > HIGHEST) return "leaves the range " + to_string(LOWEST) + " to " + to_string(HIGHEST);
+	if (highest - lowest > MAX_RANGE) return "spans more than a tenth";
+	if (count(line.begin(), line.end(), highest) != 1) return "reaches its climax more than once";
+
+	for (int i = 1; i < length; i++) {
+		const char* problem = moveProblem(line[i - 1], line[i], i >= 2 ? line[i - 1] - line[i - 2] : 0);
+		if (problem != nullptr) return "note " + to_string(i + 1) + " " + problem;
+	}
+	return "";
+}
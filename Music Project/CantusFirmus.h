@@ -0,0 +1,45 @@
+#pragma once
+#include "xorshift32.h"
+#include <memory_resource>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief
+ * A cantus firmus for the lower voice, written to the usual rules instead of GenerateLowerVoice's random walk.
+ *
+ * In scale degrees like the other voices (1 is the tonic). The line starts on the tonic and steps down from 2 to end
+ * on it, stays within LOWEST..HIGHEST and a tenth overall, and reaches its climax exactly once. It moves by steps,
+ * thirds, fourths, fifths and octaves, never repeats a note or leaps between fa and ti (a tritone), follows a leap of a
+ * fourth or more with a step back the other way, and never makes two leaps in a row in the same direction.
+ *
+ * The climax and where it falls are drawn first, then the notes in between are chosen depth first, favouring steps,
+ * undoing notes that lead nowhere. The whole line is re-planned if that runs out of steps, and the constructor throws
+ * runtime_error if none of PLAN_ATTEMPTS plans works out
+ */
+class CantusFirmus {
+public:
+	CantusFirmus(Xorshift32& rng, int length = 8, pmr::memory_resource* scratch = pmr::get_default_resource());
+	const pmr::vector<int>& getNotes() const { return notes; }
+
+	// The first rule the line breaks, or an empty string if it keeps them all
+	static string findProblem(const pmr::vector<int>& line);
+
+	static const int LOWEST = -3;
+	static const int HIGHEST = 8;
+	static const int MAX_RANGE = 9;		// A tenth, in scale steps
+	static const int PLAN_ATTEMPTS = 16;
+	static const int STEP_BUDGET = 20000;	// Notes undone per plan before giving up on it
+
+private:
+	pmr::vector<int> notes;
+	// Running lowest and highest note, lows[i] and highs[i] cover notes[0..i]
+	pmr::vector<int> lows;
+	pmr::vector<int> highs;
+
+	bool tryPlan(Xorshift32& rng, int length, int attempt, int climax, int climaxAt);
+	bool allowed(int note, int length, int climax, int climaxAt) const;
+	void push(int note);
+	void pop();
+};
@@ -0,0 +1,129 @@
+#include "CantusFirmusLibrary.h"
+#include "CantusFirmus.h"
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char LIBRARY_MAGIC[4] = { 'C', 'F', 'L', '1' };
+const int ATTEMPTS_PER_LINE = 8;	// Generation attempts per line wanted, most repeat an earlier line for short lengths
+
+struct LibraryEntry {
+	uint32_t length;
+	uint32_t count;
+	uint64_t offset;
+};
+
+CantusFirmusLibrary::CantusFirmusLibrary(const string& fileName) {
+#ifdef _WIN32
+	ifstream file(fileName, ios::binary);
+	if (!file) throw runtime_error("Couldn't open cantus firmus library: " + fileName);
+	contents.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+	data = contents.data();
+	size = contents.size();
+#else
+	int file = open(fileName.c_str(), O_RDONLY);
+	if (file < 0) throw runtime_error("Couldn't open cantus firmus library: " + fileName);
+	struct stat status;
+	if (fstat(file, &status) != 0 || status.st_size == 0) {
+		close(file);
+		throw runtime_error("Not a cantus firmus library: " + fileName);
+	}
+	size = static_cast<size_t>(status.st_size);
+	void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if (mapped == MAP_FAILED) throw runtime_error("Couldn't map cantus firmus library: " + fileName);
+	data = static_cast<const char*>(mapped);
+#endif
+
+	// Only the index is read, the notes stay on disk until a line is picked
+	uint32_t lengths = 0;
+	bool valid = size >= sizeof(LIBRARY_MAGIC) + sizeof(lengths) && memcmp(data, LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC)) == 0;
+	if (valid) {
+		memcpy(&lengths, data + sizeof(LIBRARY_MAGIC), sizeof(lengths));
+		valid = (size - sizeof(LIBRARY_MAGIC) - sizeof(lengths)) / sizeof(LibraryEntry) >= lengths;
+	}
+	for (uint32_t i = 0; valid && i < lengths; i++) {
+		LibraryEntry entry;
+		memcpy(&entry, data + sizeof(LIBRARY_MAGIC) + sizeof(lengths) + i * sizeof(LibraryEntry), sizeof(entry));
+		valid = entry.length > 0 && entry.length <= 1u << 20 && entry.offset <= size
+			&& (size - entry.offset) / entry.length >= entry.count;
+		if (!valid) break;
+		if (byLength.size() <= entry.length) byLength.resize(entry.length + 1);
+		byLength[entry.length].count = static_cast<int>(entry.count);
+		byLength[entry.length].notes = reinterpret_cast<const int8_t*>(data + entry.offset);
+	}
+	if (!valid) {
+#ifndef _WIN32
+		munmap(const_cast<char*>(data), size);
+#endif
+		throw runtime_error("Not a cantus firmus library: " + fileName);
+	}
+}
+
+CantusFirmusLibrary::~CantusFirmusLibrary() {
+#ifndef _WIN32
+	munmap(const_cast<char*>(data), size);
+#endif
+}
+
+int CantusFirmusLibrary::count(int length) const {
+	return length >= 0 && length < static_cast<int>(byLength.size()) ? byLength[length].count : 0;
+}
+
+bool CantusFirmusLibrary::pick(int length, Xorshift32& rng, pmr::vector<int>& line) const {
+	int lines = count(length);
+	if (lines == 0) return false;
+	rng.setPosition(0);
+	const int8_t* notes = byLength[length].notes + static_cast<size_t>(rng.nextInt(lines)) * length;
+	line.insert(line.end(), notes, notes + length);
+	return true;
+}
+
+vector<int> CantusFirmusLibrary::build(const string& fileName, const vector<int>& lengths, int perLength, uint32_t seed) {
+	vector<vector<int8_t>> notes;
+	vector<int> counts;
+	for (int length : lengths) {
+		if (length < 3) throw runtime_error("Cantus firmus lengths must be at least 3");
+		set<vector<int8_t>> seen;
+		vector<int8_t> all;
+		for (int attempt = 0; attempt < perLength * ATTEMPTS_PER_LINE && static_cast<int>(seen.size()) < perLength; attempt++) {
+			Xorshift32 rng(Xorshift32::deriveSeed(Xorshift32::deriveSeed(seed, static_cast<uint32_t>(length)), static_cast<uint32_t>(attempt)));
+			pmr::vector<int> line;
+			try {
+				line = CantusFirmus(rng, length).getNotes();
+			}
+			catch (runtime_error&) {
+				continue;
+			}
+			if (!CantusFirmus::findProblem(line).empty()) continue;
+			vector<int8_t> packed(line.begin(), line.end());
+			if (seen.insert(packed).second) all.insert(all.end(), packed.begin(), packed.end());
+		}
+		notes.push_back(move(all));
+		counts.push_back(static_cast<int>(seen.size()));
+	}
+
+	ofstream file(fileName, ios::binary);
+	if (!file) throw runtime_error("Couldn't open file for output: " + fileName);
+	uint32_t entries = static_cast<uint32_t>(lengths.size());
+	file.write(LIBRARY_MAGIC, sizeof(LIBRARY_MAGIC));
+	file.write(reinterpret_cast<const char*>(&entries), sizeof(entries));
+	uint64_t offset = sizeof(LIBRARY_MAGIC) + sizeof(entries) + entries * sizeof(LibraryEntry);
+	for (size_t i = 0; i < lengths.size(); i++) {
+		LibraryEntry entry = { static_cast<uint32_t>(lengths[i]), static_cast<uint32_t>(counts[i]), offset };
+		file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+		offset += notes[i].size();
+	}
+	for (const auto& lengthNotes : notes) {
+		file.write(reinterpret_cast<const char*>(lengthNotes.data()), lengthNotes.size());
+	}
+	if (!file) throw runtime_error("Couldn't write cantus firmus library: " + fileName);
+	return counts;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief
+ * Cantus firmi generated and checked ahead of time, so a request can take one instead of searching for it.
+ *
+ * The file is memory mapped and only its index is read on open, so opening is cheap however big it is and pick() is
+ * one draw and one copy. Layout, in the byte order of the machine that built it:
+ *
+ *   "CFL1", uint32 number of lengths
+ *   per length: uint32 length, uint32 count, uint64 offset of the first note from the start of the file
+ *   notes as int8 scale degrees, count lines of length notes for each length
+ *
+ * Every line in a library passed CantusFirmus::findProblem() when it was built
+ */
+class CantusFirmusLibrary {
+public:
+	// Throws runtime_error if the file can't be read or isn't a library
+	explicit CantusFirmusLibrary(const string& fileName);
+	~CantusFirmusLibrary();
+	CantusFirmusLibrary(const CantusFirmusLibrary&) = delete;
+	CantusFirmusLibrary& operator=(const CantusFirmusLibrary&) = delete;
+
+	// Lines of this many notes, 0 if the library has none
+	int count(int length) const;
+	// Appends a line of this many notes chosen with one draw, returns false if the library has none
+	bool pick(int length, Xorshift32& rng, pmr::vector<int>& line) const;
+
+	/**
+	 * @brief
+	 * Generates up to perLength different cantus firmi for each length and writes them as a library
+	 *
+	 * @return
+	 * How many lines each length got, fewer than perLength if the rules don't allow that many or they weren't found
+	 */
+	static vector<int> build(const string& fileName, const vector<int>& lengths, int perLength, uint32_t seed);
+
+private:
+	struct Lines {
+		int count = 0;
+		const int8_t* notes = nullptr;
+	};
+	vector<Lines> byLength;		// Indexed by length
+	const char* data = nullptr;
+	size_t size = 0;
+#ifdef _WIN32
+	vector<char> contents;		// No mmap, the file is read in instead
+#endif
+};
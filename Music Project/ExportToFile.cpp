@@ -1,7 +1,9 @@
 #include "ExportToFile.h"
+#include <algorithm>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include "MusicTables.h"
 #include "Note.h"
 
 
@@ -12,7 +14,7 @@ ExportToFile::ExportToFile(string fileName, string musicTitle, string composer)
 
 void ExportToFile::addPhrase(Phrase phrase) {
 	// Add phrase
-	phrases.push_back(phrase);
+	phrases.push_back(move(phrase));
 }
 
 void ExportToFile::setFileName(string fileName) {
@@ -36,6 +38,17 @@ void ExportToFile::setFileName(string fileName) {
 	this->fileName = fileName;
 }
 
+void ExportToFile::setFileName(string fileName, bool overwrite) {
+	// Verify that the file has the proper ending
+	verifyEnding(fileName);
+
+	if (!overwrite && exists(fileName)) {
+		throw runtime_error("A file already exists with the chosen output filename: " + fileName + "!");
+	}
+
+	this->fileName = fileName;
+}
+
 void ExportToFile::WriteOutput() {
 
 	// Open/create file for output
@@ -46,7 +59,17 @@ void ExportToFile::WriteOutput() {
 		throw runtime_error("Couldn't open file for output!");
 	}
 
-	// Else use that file stream and start writing our output
+	// Else use that file stream and write our output
+	WriteOutput(outputFileStream);
+
+	// Close the file
+	outputFileStream.close();
+
+	// Report Success
+	cout << "Final output file successfully created!" << endl;
+}
+
+void ExportToFile::WriteOutput(ostream& outputFileStream) {
 
 	// Output general header information
 	outputFileStream << "\\header {" << endl
@@ -59,13 +82,37 @@ void ExportToFile::WriteOutput() {
 		<< "}" << endl << endl << endl;
 		//<< "global = { \\key " << key << " \\major \\time " << time << " }" << endl << endl << endl;
 
+	// Every phrase gets a staff for each voice of the phrase with the most, two unless some have inner voices
+	int staffCount = 2;
+	for (const auto& phrase : phrases) {
+		staffCount = max(staffCount, phrase.getVoiceCount());
+	}
+
 	// Loop through phrases to be printed
 	int numPhrases = 0;
-	for (auto phrase : phrases) {
-		// Write the current phrase -- Writes the upper and lower voice
-		writePhrase(phrase, ++numPhrases, outputFileStream);
+	for (const auto& phrase : phrases) {
+		// Write the current phrase -- Writes every voice
+		writePhrase(phrase, ++numPhrases, staffCount, outputFileStream);
 	} // End of loop for printing phrases
 
+	if (staffCount > 2) {
+		// One staff per voice, top first
+		outputFileStream << "\\score {" << endl
+			<< "	<<" << endl;
+		for (int staff = 0; staff < staffCount; staff++) {
+			outputFileStream << "		\\new Staff {" << endl;
+			for (int i = 1; i <= numPhrases; i++) {
+				outputFileStream << "			\\\"" << staffName(staff, staffCount) << i << "\"" << endl;
+			}
+			outputFileStream << "		}" << endl;
+		}
+		outputFileStream << "	>>" << endl
+			<< "		\\layout{}" << endl
+			<< "		\\midi{}" << endl
+			<< "}" << endl;
+		return;
+	}
+
 	// Output final info for file
 	outputFileStream << "\\score {" << endl
 		<< "	<<" << endl
@@ -93,36 +140,46 @@ void ExportToFile::WriteOutput() {
 		<< "		\\layout{}" << endl
 		<< "		\\midi{}" << endl
 		<< "}" << endl;
-
-	// Close the file
-	outputFileStream.close();
-
-	// Report Success
-	cout << "Final output file successfully created!" << endl;
 }
 
-void ExportToFile::writePhrase(Phrase phrase, int phraseNumber, ofstream& outputFileStream) {
-	// Set top and bottom phrase names
-	string topPhraseName = "\"topPhrase" + to_string(phraseNumber) + "\"";
-	string bottomPhraseName = "\"bottomPhrase" + to_string(phraseNumber) + "\"";
+string ExportToFile::staffName(int staff, int staffCount) {
+	if (staff == 0) return "topPhrase";
+	if (staff == staffCount - 1) return "bottomPhrase";
+	return "middle" + to_string(staff) + "Phrase";
+}
 
+void ExportToFile::writePhrase(const Phrase& phrase, int phraseNumber, int staffCount, ostream& outputFileStream) {
 	// write comment with phrase info
 	outputFileStream << "% Phrase " << phraseNumber << endl;
-	outputFileStream << topPhraseName << " = { \\clef \"treble\" \\key " << phrase.getKey() << " \\major \\time " << phrase.getTimeSig() << endl;
-	// Time to print out the notes for the top voice of this phrase
-	for (auto note : phrase.getUpperVoice()) {
-		outputFileStream << " " << convertNoteToOutput(*note);
+
+	// A phrase with fewer voices than staves rests in the inner staves it has no voice for
+	int eighths = 0;
+	const Voice& upperVoice = phrase.getUpperVoice();
+	for (size_t i = 0; i < upperVoice.size(); i++) {
+		eighths += upperVoice.at(i).getEighths();
 	}
-	// End top voice of this phrase
-	outputFileStream << "\\bar \"||\" }" << endl;
 
-	outputFileStream << bottomPhraseName << " = { \\clef \"treble\" \\key " << phrase.getKey() << " \\major \\time " << phrase.getTimeSig() << endl;
-	// Time to print out the notes for the bottom voice of this phrase
-	for (auto note : phrase.getLowerVoice()) {
-		outputFileStream << " " << convertNoteToOutput(*note);
+	for (int staff = 0; staff < staffCount; staff++) {
+		// Two voices keep both staves in the treble clef, more put the lower half in the bass clef. A two voice
+		// phrase's lower voice stays in the treble clef whatever staff it is on
+		bool lowerHalf = staffCount > 2 && 2 * staff >= staffCount;
+		string clef = lowerHalf && (phrase.getVoiceCount() > 2 || staff < staffCount - 1) ? "bass" : "treble";
+		outputFileStream << "\"" << staffName(staff, staffCount) << phraseNumber << "\" = { \\clef \"" << clef << "\" \\key " << phrase.getKey()
+			<< " \\major \\time " << phrase.getTimeSig() << endl;
+		int voice = staff == staffCount - 1 ? phrase.getVoiceCount() - 1 : staff;
+		if (staff == staffCount - 1 || staff < phrase.getVoiceCount() - 1) {
+			const Voice& notes = phrase.getVoice(voice);
+			for (size_t i = 0; i < notes.size(); i++) {
+				outputFileStream << ' ';
+				writeNote(notes.at(i), outputFileStream);
+			}
+		}
+		else {
+			outputFileStream << " s8*" << eighths;
+		}
+		// The double bar at the end of the phrase is written once, in the top voice
+		outputFileStream << (staff == 0 ? "\\bar \"||\" }" : "}") << endl;
 	}
-	// End bottom voice of this phrase
-	outputFileStream << "}" << endl;
 }
 
 bool ExportToFile::exists(const string& fileName) {
@@ -182,186 +239,16 @@ NOTES_HERE}
 
  */
 
-string ExportToFile::convertNoteToOutput(Note note) const {
-	const string noteLengthString = to_string(note.getLength());
-	switch (note.getNote()) {
-	case Note_A0:
-		return "a,,," + noteLengthString;
-	case Note_A0_sharp:
-		return "ais,,," + noteLengthString;
-	case Note_B0:
-		return "b,,," + noteLengthString;
-	case Note_C1:
-		return "c,," + noteLengthString;
-	case Note_C1_sharp:
-		return "cis,," + noteLengthString;
-	case Note_D1:
-		return "d,," + noteLengthString;
-	case Note_D1_sharp:
-		return "dis,," + noteLengthString;
-	case Note_E1:
-		return "e,," + noteLengthString;
-	case Note_F1:
-		return "f,," + noteLengthString;
-	case Note_F1_sharp:
-		return "fis,," + noteLengthString;
-	case Note_G1:
-		return "g,," + noteLengthString;
-	case Note_G1_sharp:
-		return "gis,," + noteLengthString;
-	case Note_A1:
-		return "a,," + noteLengthString;
-	case Note_A1_sharp:
-		return "ais,," + noteLengthString;
-	case Note_B1:
-		return "b,," + noteLengthString;
-	case Note_C2:
-		return "c," + noteLengthString;
-	case Note_C2_sharp:
-		return "cis," + noteLengthString;
-	case Note_D2:
-		return "d," + noteLengthString;
-	case Note_D2_sharp:
-		return "dis," + noteLengthString;
-	case Note_E2:
-		return "e," + noteLengthString;
-	case Note_F2:
-		return "f," + noteLengthString;
-	case Note_F2_sharp:
-		return "fis," + noteLengthString;
-	case Note_G2:
-		return "g," + noteLengthString;
-	case Note_G2_sharp:
-		return "gis," + noteLengthString;
-	case Note_A2:
-		return "a," + noteLengthString;
-	case Note_A2_sharp:
-		return "ais," + noteLengthString;
-	case Note_B2:
-		return "b," + noteLengthString;
-	case Note_C3:
-		return "c" + noteLengthString;
-	case Note_C3_sharp:
-		return "cis" + noteLengthString;
-	case Note_D3:
-		return "d" + noteLengthString;
-	case Note_D3_sharp:
-		return "dis" + noteLengthString;
-	case Note_E3:
-		return "e" + noteLengthString;
-	case Note_F3:
-		return "f" + noteLengthString;
-	case Note_F3_sharp:
-		return "fis" + noteLengthString;
-	case Note_G3:
-		return "g" + noteLengthString;
-	case Note_G3_sharp:
-		return "gis" + noteLengthString;
-	case Note_A3:
-		return "a" + noteLengthString;
-	case Note_A3_sharp:
-		return "ais" + noteLengthString;
-	case Note_B3:
-		return "b" + noteLengthString;
-	case Note_C4:
-		return "c'" + noteLengthString;
-	case Note_C4_sharp:
-		return "cis'" + noteLengthString;
-	case Note_D4:
-		return "d'" + noteLengthString;
-	case Note_D4_sharp:
-		return "dis'" + noteLengthString;
-	case Note_E4:
-		return "e'" + noteLengthString;
-	case Note_F4:
-		return "f'" + noteLengthString;
-	case Note_F4_sharp:
-		return "fis'" + noteLengthString;
-	case Note_G4:
-		return "g'" + noteLengthString;
-	case Note_G4_sharp:
-		return "gis'" + noteLengthString;
-	case Note_A4:
-		return "a'" + noteLengthString;
-	case Note_A4_sharp:
-		return "ais'" + noteLengthString;
-	case Note_B4:
-		return "b'" + noteLengthString;
-	case Note_C5:
-		return "c''" + noteLengthString;
-	case Note_C5_sharp:
-		return "cis''" + noteLengthString;
-	case Note_D5:
-		return "d''" + noteLengthString;
-	case Note_D5_sharp:
-		return "dis''" + noteLengthString;
-	case Note_E5:
-		return "e''" + noteLengthString;
-	case Note_F5:
-		return "f''" + noteLengthString;
-	case Note_F5_sharp:
-		return "fis''" + noteLengthString;
-	case Note_G5:
-		return "g''" + noteLengthString;
-	case Note_G5_sharp:
-		return "gis''" + noteLengthString;
-	case Note_A5:
-		return "a''" + noteLengthString;
-	case Note_A5_sharp:
-		return "ais''" + noteLengthString;
-	case Note_B5:
-		return "b''" + noteLengthString;
-	case Note_C6:
-		return "c'''" + noteLengthString;
-	case Note_C6_sharp:
-		return "cis'''" + noteLengthString;
-	case Note_D6:
-		return "d'''" + noteLengthString;
-	case Note_D6_sharp:
-		return "dis'''" + noteLengthString;
-	case Note_E6:
-		return "e'''" + noteLengthString;
-	case Note_F6:
-		return "f'''" + noteLengthString;
-	case Note_F6_sharp:
-		return "fis'''" + noteLengthString;
-	case Note_G6:
-		return "g'''" + noteLengthString;
-	case Note_G6_sharp:
-		return "gis'''" + noteLengthString;
-	case Note_A6:
-		return "a'''" + noteLengthString;
-	case Note_A6_sharp:
-		return "ais'''" + noteLengthString;
-	case Note_B6:
-		return "b'''" + noteLengthString;
-	case Note_C7:
-		return "c''''" + noteLengthString;
-	case Note_C7_sharp:
-		return "cis''''" + noteLengthString;
-	case Note_D7:
-		return "d''''" + noteLengthString;
-	case Note_D7_sharp:
-		return "dis''''" + noteLengthString;
-	case Note_E7:
-		return "e''''" + noteLengthString;
-	case Note_F7:
-		return "f''''" + noteLengthString;
-	case Note_F7_sharp:
-		return "fis''''" + noteLengthString;
-	case Note_G7:
-		return "g''''" + noteLengthString;
-	case Note_G7_sharp:
-		return "gis''''" + noteLengthString;
-	case Note_A7:
-		return "a''''" + noteLengthString;
-	case Note_A7_sharp:
-		return "ais''''" + noteLengthString;
-	case Note_B7:
-		return "b''''" + noteLengthString;
-	case Note_C8:
-		return "c'''''" + noteLengthString;
-	default:
+void ExportToFile::writeNote(Note note, ostream& outputFileStream) const {
+	size_t pitch = note.getNote();
+	if (pitch >= NUM_NOTES) {
 		throw runtime_error("Error, could not convert note to proper output for lily pond!");
 	}
-}
\ No newline at end of file
+	outputFileStream << NOTE_NAMES[pitch] << note.getLength();
+	if (note.isDotted()) {
+		outputFileStream << '.';
+	}
+	if (note.isTied()) {
+		outputFileStream << '~';
+	}
+}
@@ -2,6 +2,7 @@
 #include "Note.h"
 #include "Phrase.h"
 #include <string>
+#include <ostream>
 #include <vector>
 
 using namespace std;
@@ -15,14 +16,19 @@ public:
 	ExportToFile() = default;
 
 	// Mutators
+	// Pass an rvalue (e.g. WritePhrase::takePhrase()) and the phrase is moved in, never copied
 	void addPhrase(Phrase phrase);
 	void setFileName(string fileName);
+	// Never prompts: overwrites an existing file if overwrite is set, otherwise throws
+	void setFileName(string fileName, bool overwrite);
 	void forceSetFileName(string fileName) { verifyEnding(fileName); this->fileName = fileName; }
 	void setComposer(string composer) { this->composer = composer; }
 	void setTitle(string title) { this->title = title; }
 
 	// Final output function, writes all phrases and everything
 	void WriteOutput();
+	// Same output written to any stream instead of the file, no file is created and nothing is printed
+	void WriteOutput(ostream& outputFileStream);
 
 private:
 	// Private data members
@@ -33,9 +39,12 @@ private:
 	vector<Phrase> phrases;
 
 	// Other helper functions
-	string convertNoteToOutput(Note note) const;
-	// Function to write the upper and lower voice for one phrase
-	void writePhrase(Phrase phrase, int phraseNumber, ofstream &outputFileStream);
+	// Writes a note as LilyPond pitch and length, e.g. cis'4 or cis'2. when dotted, with a ~ if it is tied into the next
+	void writeNote(Note note, ostream& outputFileStream) const;
+	// Function to write every voice of one phrase, one definition per staff of the score
+	void writePhrase(const Phrase& phrase, int phraseNumber, int staffCount, ostream &outputFileStream);
+	// Name of a staff's phrase definitions: topPhrase, middle1Phrase ... and bottomPhrase
+	static string staffName(int staff, int staffCount);
 	// Check to see if a file exists
 	static bool exists(const string& fileName);
 	// Verifies that a filename has a proper ending
@@ -1,14 +1,15 @@
 #include "GenerateLowerVoice.h"
-#include "xorshift32.h"
 #include <vector>
 #include <iostream>
 
-GenerateLowerVoice::GenerateLowerVoice(int length) {
+GenerateLowerVoice::GenerateLowerVoice(Xorshift32& rng, int length, pmr::memory_resource* scratch) : lowerVoice(scratch), rng(rng) {
 	this->length = length;
+	lowerVoice.reserve(length > 3 ? length : 3);
 
 	lowerVoice.push_back(1);
 
 	for (int i = 0; i < length - 3; i++) {
+		rng.setPosition(i + 1);
 		int nextNote;
 		if (lowerVoice.back() < -1) {
 			nextNote = lowerVoice.back() + pickRandomInterval() -1;
@@ -16,7 +17,7 @@ GenerateLowerVoice::GenerateLowerVoice(int length) {
 		else if (lowerVoice.back() > 4) {
 			nextNote = lowerVoice.back() - pickRandomInterval() -1;
 		}
-		else if (Xorshift32::nextFloat() < 0.5) {
+		else if (rng.nextFloat() < 0.5) {
 			nextNote = lowerVoice.back() + pickRandomInterval() -1;
 		}
 		else {
@@ -29,7 +30,7 @@ GenerateLowerVoice::GenerateLowerVoice(int length) {
 }
 
 int GenerateLowerVoice::pickRandomInterval() {
-	switch (Xorshift32::nextInt(20)) {
+	switch (rng.nextInt(20)) {
 	case 0:
 	case 1:
 	case 2:
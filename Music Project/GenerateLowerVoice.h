@@ -1,16 +1,19 @@
 #pragma once
 #include "Note.h"
+#include "xorshift32.h"
+#include <memory_resource>
 #include <vector>
 using namespace std;
 
 class GenerateLowerVoice {
 public:
-	GenerateLowerVoice(int length = 8);
+	GenerateLowerVoice(Xorshift32& rng, int length = 8, pmr::memory_resource* scratch = pmr::get_default_resource());
 	int pickRandomInterval();
-	vector<int> getLowerVoice() { return lowerVoice; }
+	const pmr::vector<int>& getLowerVoice() const { return lowerVoice; }
 	void printLowerVoice();
 
 private:
-	vector<int> lowerVoice;
+	pmr::vector<int> lowerVoice;
 	int length;
+	Xorshift32& rng;
 };
@@ -1,5 +1,6 @@
 #include <iostream>
 #include <limits>
+#include <ctime>
 #include "HelperFunctions.h"
 #include "ExportToFile.h"
 #include "WritePhrase.h"
@@ -103,7 +104,7 @@ void GenerateNoteVector() {
 
 /**
  * @brief
- * This function is used to generate the code for the ExportToFile::convertNoteToOutput function -- please don't remove this function as we may want to use it later
+ * This function is used to generate the code for the note to LilyPond conversion (now NOTE_NAMES in MusicTables.h) -- please don't remove this function as we may want to use it later
  */
 void GenerateNoteConversionCases() {
 	char letter = 'A';
@@ -150,7 +151,7 @@ void GenerateNoteConversionCases() {
 
 /**
  * @brief
- * This function is a helper function for the one above used to generate the code for the ExportToFile::convertNoteToOutput function -- please don't remove this function as we may want to use it later
+ * This function is a helper function for the one above used to generate the code for the note to LilyPond conversion -- please don't remove this function as we may want to use it later
  */
 string getSuffix(int keyLabelNumber) {
 	switch (keyLabelNumber) {
@@ -194,10 +195,10 @@ void tests1() {
 	Note note3(Note_D4, 4);
 	Note note4(Note_D4, 2);
 
-	const vector<Note*> upperPhrase1 = {&note1, &note2};
-	const vector<Note*> lowerPhrase1 = {&note3, &note4};
-	const vector<Note*> upperPhrase2 = {&note2, &note1};
-	const vector<Note*> lowerPhrase2 = {&note4, &note3};
+	const vector<Note> upperPhrase1 = {note1, note2};
+	const vector<Note> lowerPhrase1 = {note3, note4};
+	const vector<Note> upperPhrase2 = {note2, note1};
+	const vector<Note> lowerPhrase2 = {note4, note3};
 
 	// Create some phrases
 	Phrase phrase1(upperPhrase1, lowerPhrase1);
@@ -230,7 +231,9 @@ void tests2() {
 		test.printLowerVoice();
 	}
 	*/
-	WritePhrase phrase1("C", 3);
+	Xorshift32 rng(static_cast<uint32_t>(time(0)));
+
+	WritePhrase phrase1("C", 3, rng);
 	phrase1.writeThePhrase();
 	phrase1.printPhraseI();
 	phrase1.calculateInterval();
@@ -238,7 +241,7 @@ void tests2() {
 	phrase1.printPhraseN();
 	cout << endl;
 
-	WritePhrase phrase2("D", 3);
+	WritePhrase phrase2("D", 3, rng);
 	phrase2.setSpeciesType(0);
 	phrase2.writeThePhrase();
 	phrase2.printPhraseI();
@@ -246,7 +249,7 @@ void tests2() {
 	cout << endl;
 	phrase2.printPhraseN();
 
-	WritePhrase phrase3("Bb", 3);
+	WritePhrase phrase3("Bb", 3, rng);
 	phrase3.writeThePhrase();
 	phrase3.printPhraseI();
 	phrase3.calculateInterval();
@@ -254,7 +257,7 @@ void tests2() {
 	phrase3.printPhraseN();
 	cout << endl;
 
-	WritePhrase phrase4("F", 4);
+	WritePhrase phrase4("F", 4, rng);
 	phrase4.setSpeciesType(0);
 	phrase4.writeThePhrase();
 	phrase4.printPhraseI();
@@ -262,7 +265,7 @@ void tests2() {
 	cout << endl;
 	phrase4.printPhraseN();
 
-	WritePhrase phrase5("C", 4);
+	WritePhrase phrase5("C", 4, rng);
 	phrase4.setSpeciesType(2);
 	phrase4.writeThePhrase();
 	phrase4.printPhraseI();
@@ -0,0 +1,406 @@
+#include "HttpServer.h"
+#include "MusicTables.h"
+#include "SpeciesOneVoices.h"
+#include "WorkStealingPool.h"
+#include "WritePhrase.h"
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef SOCKET SocketHandle;
+static void closeSocket(SocketHandle socket) { closesocket(socket); }
+#else
+#include <arpa/inet.h>
+#include <csignal>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+typedef int SocketHandle;
+static const SocketHandle INVALID_SOCKET = -1;
+static void closeSocket(SocketHandle socket) { close(socket); }
+#endif
+
+// Largest phrase a request may ask for, so one request can't tie up a worker for long
+const int MAX_MEASURES = 1000;
+const int MAX_BEATS = 16;
+const int MAX_BEAM_WIDTH = 4096;	// Wide beams are slow, and served requests run one per pool thread
+const int MAX_BEAM_NOTES = 1 << 22;	// Width times notes, the lines a beam search expands in all
+
+static bool sendResponse(SocketHandle connection, const HttpServer::Response& response, bool keepAlive, chrono::steady_clock::time_point deadline);
+
+HttpServer::HttpServer(const string& host, int port, int threads, size_t cacheSize) : host(host), port(port), threads(threads), cache(cacheSize) {
+}
+
+void HttpServer::run() {
+#ifdef _WIN32
+	WSADATA wsaData;
+	if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) throw runtime_error("Couldn't start Winsock!");
+#else
+	// A client hanging up mid-response should fail that send, not kill the server
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+	if (listener == INVALID_SOCKET) throw runtime_error("Couldn't create socket!");
+	int reuse = 1;
+	setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address = {};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(static_cast<uint16_t>(port));
+	if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+		closeSocket(listener);
+		throw runtime_error("Invalid host address: " + host);
+	}
+	if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listener, SOMAXCONN) != 0) {
+		closeSocket(listener);
+		throw runtime_error("Couldn't listen on " + host + ":" + to_string(port));
+	}
+
+	WorkStealingPool pool(threads);
+	cout << "Serving on http://" << host << ":" << port << " with " << pool.size() << " workers" << endl;
+
+	while (true) {
+		SocketHandle connection = accept(listener, nullptr, nullptr);
+		if (connection == INVALID_SOCKET) {
+			// Errors such as running out of file descriptors persist for a while, so don't retry in a busy loop
+			this_thread::sleep_for(chrono::milliseconds(ACCEPT_RETRY_MILLISECONDS));
+			continue;
+		}
+
+		// Close idle keep-alive connections, and give up on clients that stop reading, so they don't hold a worker
+		// forever
+#ifdef _WIN32
+		DWORD timeout = IDLE_TIMEOUT_SECONDS * 1000;
+#else
+		timeval timeout = {};
+		timeout.tv_sec = IDLE_TIMEOUT_SECONDS;
+#endif
+		setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+		setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<const char*>(&timeout), sizeof(timeout));
+		int noDelay = 1;
+		setsockopt(connection, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+
+		// Every worker busy and enough waiting already, so this one is turned away rather than queued without limit
+		if (queuedConnections >= MAX_QUEUED_CONNECTIONS) {
+			sendResponse(connection, { 503, "Too many connections, try again later\n" }, false,
+				chrono::steady_clock::now() + chrono::seconds(REQUEST_TIMEOUT_SECONDS));
+			closeSocket(connection);
+			continue;
+		}
+		queuedConnections++;
+		pool.submit([this, connection] {
+			queuedConnections--;
+			serveConnection(static_cast<int>(connection));
+		});
+	}
+}
+
+static string reasonPhrase(int status) {
+	switch (status) {
+	case 200:
+		return "OK";
+	case 400:
+		return "Bad Request";
+	case 404:
+		return "Not Found";
+	case 405:
+		return "Method Not Allowed";
+	case 408:
+		return "Request Timeout";
+	case 413:
+		return "Payload Too Large";
+	case 501:
+		return "Not Implemented";
+	case 503:
+		return "Service Unavailable";
+	default:
+		return "Internal Server Error";
+	}
+}
+
+// Gives up on a client that reads too slowly to take everything by deadline
+static bool sendAll(SocketHandle connection, const string& data, chrono::steady_clock::time_point deadline) {
+	size_t sent = 0;
+	while (sent < data.size()) {
+		if (chrono::steady_clock::now() > deadline) return false;
+		int count = send(connection, data.data() + sent, static_cast<int>(data.size() - sent), 0);
+		if (count <= 0) return false;
+		sent += count;
+	}
+	return true;
+}
+
+static bool sendResponse(SocketHandle connection, const HttpServer::Response& response, bool keepAlive, chrono::steady_clock::time_point deadline) {
+	string message = "HTTP/1.1 " + to_string(response.status) + " " + reasonPhrase(response.status) + "\r\n"
+		+ "Content-Type: text/plain; charset=utf-8\r\n"
+		+ "Content-Length: " + to_string(response.body.size()) + "\r\n"
+		+ "Connection: " + (keepAlive ? "keep-alive" : "close") + "\r\n\r\n"
+		+ response.body;
+	return sendAll(connection, message, deadline);
+}
+
+void HttpServer::serveConnection(int socketValue) {
+	SocketHandle connection = static_cast<SocketHandle>(socketValue);
+	string buffer;
+	char chunk[4096];
+	using Clock = chrono::steady_clock;
+	auto fromNow = [] { return Clock::now() + chrono::seconds(REQUEST_TIMEOUT_SECONDS); };
+
+	while (true) {
+		// Read until the end of the headers. The request's time starts with its first byte, which is already here if
+		// it was pipelined behind the last one
+		Clock::time_point deadline = buffer.empty() ? Clock::time_point::max() : fromNow();
+		size_t headerEnd;
+		while ((headerEnd = buffer.find("\r\n\r\n")) == string::npos) {
+			if (Clock::now() > deadline) {
+				sendResponse(connection, { 408, "Request took too long to arrive\n" }, false, fromNow());
+				closeSocket(connection);
+				return;
+			}
+			if (buffer.size() > MAX_REQUEST_BYTES) {
+				sendResponse(connection, { 413, "Request headers too large\n" }, false, fromNow());
+				closeSocket(connection);
+				return;
+			}
+			int count = recv(connection, chunk, sizeof(chunk), 0);
+			if (count <= 0) {	// Closed by the client, or idle too long
+				closeSocket(connection);
+				return;
+			}
+			if (buffer.empty()) deadline = fromNow();
+			buffer.append(chunk, count);
+		}
+
+		// Request line and headers, header names are case insensitive
+		stringstream head(buffer.substr(0, headerEnd));
+		string requestLine, method, target, version;
+		getline(head, requestLine);
+		stringstream requestLineStream(requestLine);
+		if (!(requestLineStream >> method >> target >> version) || version.compare(0, 5, "HTTP/") != 0) {
+			sendResponse(connection, { 400, "Malformed request line\n" }, false, fromNow());
+			closeSocket(connection);
+			return;
+		}
+		map<string, string> headers;
+		string line;
+		while (getline(head, line)) {
+			if (!line.empty() && line.back() == '\r') line.pop_back();
+			size_t colon = line.find(':');
+			if (colon == string::npos) continue;
+			string name = line.substr(0, colon);
+			for (auto& letter : name) letter = static_cast<char>(tolower(letter));
+			size_t valueStart = line.find_first_not_of(" \t", colon + 1);
+			headers[name] = valueStart == string::npos ? "" : line.substr(valueStart);
+		}
+
+		string connectionHeader = headers["connection"];
+		for (auto& letter : connectionHeader) letter = static_cast<char>(tolower(letter));
+		bool keepAlive = version == "HTTP/1.0" ? connectionHeader == "keep-alive" : connectionHeader != "close";
+
+		if (headers.count("transfer-encoding")) {
+			sendResponse(connection, { 501, "Chunked request bodies are not supported\n" }, false, fromNow());
+			closeSocket(connection);
+			return;
+		}
+		size_t contentLength = 0;
+		try {
+			contentLength = headers.count("content-length") ? stoul(headers["content-length"]) : 0;
+		}
+		catch (logic_error&) {
+			sendResponse(connection, { 400, "Invalid Content-Length\n" }, false, fromNow());
+			closeSocket(connection);
+			return;
+		}
+		if (contentLength > MAX_REQUEST_BYTES) {
+			sendResponse(connection, { 413, "Request body too large\n" }, false, fromNow());
+			closeSocket(connection);
+			return;
+		}
+
+		// Read the rest of the body
+		size_t bodyStart = headerEnd + 4;
+		while (buffer.size() < bodyStart + contentLength) {
+			if (Clock::now() > deadline) {
+				sendResponse(connection, { 408, "Request took too long to arrive\n" }, false, fromNow());
+				closeSocket(connection);
+				return;
+			}
+			int count = recv(connection, chunk, sizeof(chunk), 0);
+			if (count <= 0) {
+				closeSocket(connection);
+				return;
+			}
+			buffer.append(chunk, count);
+		}
+
+		Response response = handle(method, target, buffer.substr(bodyStart, contentLength));
+		// Anything after this request is the start of the next one (pipelining)
+		buffer.erase(0, bodyStart + contentLength);
+		if (!sendResponse(connection, response, keepAlive, fromNow()) || !keepAlive) break;
+	}
+	closeSocket(connection);
+}
+
+HttpServer::Response HttpServer::handle(const string& method, const string& target, const string& body) {
+	size_t queryStart = target.find('?');
+	string path = target.substr(0, queryStart);
+	map<string, string> fields = parseForm(queryStart == string::npos ? "" : target.substr(queryStart + 1));
+
+	if (method != "GET" && method != "POST") return { 405, "Only GET and POST are supported\n" };
+	if (path == "/health") return { 200, "ok\n" };
+	if (path == "/stats") {
+		RenderCache::Stats stats = cache.getStats();
+		BacktrackStats backtracking = WritePhrase::getTotalBacktrackStats();
+		return { 200, "hits " + to_string(stats.hits) + "\nmisses " + to_string(stats.misses) + "\nevictions " + to_string(stats.evictions)
+			+ "\nsize " + to_string(stats.size) + "\ncapacity " + to_string(stats.capacity)
+			+ "\nbacktracks " + to_string(backtracking.backtracks) + "\nbacktrack_failures " + to_string(backtracking.failures) + "\n" };
+	}
+	if (path != "/generate" && path != "/voices") return { 404, "Unknown path: " + path + "\n" };
+
+	if (method == "POST") {
+		for (const auto& field : parseForm(body)) {
+			fields[field.first] = field.second;
+		}
+	}
+	GenerationJob job;
+	RngMode mode;
+	string error;
+	if (!parseJob(fields, job, mode, error)) return { 400, error + "\n" };
+	if (job.lowerVoice == Lower_Cantus || job.voices > 2) job.library = cantusLibrary;
+
+	try {
+		shared_ptr<const RenderedPhrase> rendered = cache.get(job, mode);
+		if (path == "/generate") return { 200, rendered->output };
+
+		string voices = "upper:";
+		for (auto degree : rendered->upperVoiceI) voices += " " + to_string(degree);
+		for (size_t i = 0; i < rendered->middleVoicesI.size(); i++) {
+			voices += "\nmiddle" + to_string(i + 1) + ":";
+			for (auto degree : rendered->middleVoicesI[i]) voices += " " + to_string(degree);
+		}
+		voices += "\nlower:";
+		for (auto degree : rendered->lowerVoiceI) voices += " " + to_string(degree);
+		return { 200, voices + "\n" };
+	}
+	catch (runtime_error& exception) {	// e.g. a note outside the 88 LilyPond can name
+		return { 400, string(exception.what()) + "\n" };
+	}
+	catch (exception& exception) {
+		return { 500, string(exception.what()) + "\n" };
+	}
+}
+
+map<string, string> HttpServer::parseForm(const string& form) {
+	map<string, string> fields;
+	stringstream stream(form);
+	string pair;
+	while (getline(stream, pair, '&')) {
+		if (pair.empty()) continue;
+		size_t equals = pair.find('=');
+		string name = decodeComponent(pair.substr(0, equals));
+		fields[name] = equals == string::npos ? "" : decodeComponent(pair.substr(equals + 1));
+	}
+	return fields;
+}
+
+string HttpServer::decodeComponent(const string& component) {
+	// "+" is a space and %XX a byte, so F# arrives as F%23
+	string decoded;
+	for (size_t i = 0; i < component.size(); i++) {
+		if (component[i] == '+') {
+			decoded += ' ';
+		}
+		else if (component[i] == '%' && i + 2 < component.size() && isxdigit(component[i + 1]) && isxdigit(component[i + 2])) {
+			decoded += static_cast<char>(stoi(component.substr(i + 1, 2), nullptr, 16));
+			i += 2;
+		}
+		else {
+			decoded += component[i];
+		}
+	}
+	return decoded;
+}
+
+bool HttpServer::parseJob(const map<string, string>& fields, GenerationJob& job, RngMode& mode, string& error) {
+	for (const char* name : { "seed", "key", "species", "measures", "beats" }) {
+		if (!fields.count(name)) {
+			error = string("Missing parameter: ") + name + " (need seed, key, species, measures and beats)";
+			return false;
+		}
+	}
+	try {
+		job.seed = static_cast<uint32_t>(stoll(fields.at("seed")));
+		job.key = fields.at("key");
+		job.species = stoi(fields.at("species"));
+		job.measures = stoi(fields.at("measures"));
+		job.beats = stoi(fields.at("beats"));
+	}
+	catch (logic_error&) {
+		error = "Parameters seed, species, measures and beats must be numbers";
+		return false;
+	}
+	try {
+		parseKey(job.key);
+		checkMeter(job.species, job.beats);
+		if (fields.count("engine")) job.engine = parseEngine(fields.at("engine"));
+		if (fields.count("lower")) job.lowerVoice = parseLowerVoice(fields.at("lower"));
+		if (fields.count("two")) job.speciesTwo = parseSpeciesTwo(fields.at("two"));
+	}
+	catch (runtime_error& exception) {
+		error = exception.what();
+		return false;
+	}
+	try {
+		if (fields.count("width")) job.beam.width = stoi(fields.at("width"));
+		job.beam.threads = 1;	// Requests already run one per pool thread
+		if (fields.count("voices")) job.voices = stoi(fields.at("voices"));
+	}
+	catch (logic_error&) {
+		error = "Parameters width and voices must be numbers";
+		return false;
+	}
+	if (job.beam.width < 1 || job.beam.width > MAX_BEAM_WIDTH) {
+		error = "width must be 1-" + to_string(MAX_BEAM_WIDTH);
+		return false;
+	}
+	if (job.species < 0 || job.species > 5) {
+		error = "species must be 0-5";
+		return false;
+	}
+	if (job.voices < 2 || job.voices > SpeciesOneVoices::MAX_VOICES) {
+		error = "voices must be 2-" + to_string(SpeciesOneVoices::MAX_VOICES);
+		return false;
+	}
+	if (job.measures < 1 || job.measures > MAX_MEASURES || job.beats < 1 || job.beats > MAX_BEATS) {
+		error = "measures must be 1-" + to_string(MAX_MEASURES) + " and beats 1-" + to_string(MAX_BEATS);
+		return false;
+	}
+	if (job.engine == Engine_Beam && job.beam.width * job.measures * job.beats > MAX_BEAM_NOTES) {
+		error = "width * measures * beats must be at most " + to_string(MAX_BEAM_NOTES) + " for the beam engine";
+		return false;
+	}
+
+	string rng = fields.count("rng") ? fields.at("rng") : "stream";
+	if (rng == "stream") {
+		mode = Rng_Stream;
+	}
+	else if (rng == "counter") {
+		mode = Rng_Counter;
+	}
+	else {
+		error = "Unknown rng mode: " + rng;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include "Batch.h"
+#include "RenderCache.h"
+#include <atomic>
+#include <map>
+#include <string>
+using namespace std;
+
+// Small HTTP/1.1 server that keeps the generator in one warm process. Connections are kept alive and handled by a
+// WorkStealingPool, one connection per worker at a time, and close after IDLE_TIMEOUT_SECONDS without a request.
+// A request has REQUEST_TIMEOUT_SECONDS from its first byte to arrive, and its response as long again to be sent.
+// Connections past MAX_QUEUED_CONNECTIONS waiting for a worker get a 503.
+//
+//   GET /generate?seed=1&key=C&species=1&measures=4&beats=4[&rng=stream|counter][&engine=uniform...][&width=N][&lower=cantus][&two=derived][&voices=N]
+//     200 with the LilyPond text ExportToFile::WriteOutput would have written for the same CLI parameters
+//     (POST with the same fields as an application/x-www-form-urlencoded body works too)
+//   GET /voices?... (same parameters)
+//     200 with the phrase's scale degrees, "upper: ..." and "lower: ..." lines, with "middle1: ..." and so on between
+//     them for more than two voices
+//   GET /stats
+//     200 with the render cache's hits, misses, evictions, size and capacity
+//   GET /health
+//     200 "ok"
+// Generated phrases are kept in a RenderCache, so repeated requests skip generation.
+class HttpServer {
+public:
+	HttpServer(const string& host, int port, int threads = 0, size_t cacheSize = 1024);
+	// Accepts connections until the process is stopped, throws if the socket can't be set up
+	void run();
+	// Requests with lower=cantus pick from this library when it has their length. Not owned, must outlive run()
+	void setCantusLibrary(const CantusFirmusLibrary* library) { cantusLibrary = library; }
+
+	// Response status and body for one request, usable without a socket
+	struct Response {
+		int status = 200;
+		string body;
+	};
+	Response handle(const string& method, const string& target, const string& body);
+
+	static const int IDLE_TIMEOUT_SECONDS = 5;
+	static constexpr int REQUEST_TIMEOUT_SECONDS = 10;
+	static const int MAX_QUEUED_CONNECTIONS = 64;
+	static constexpr int ACCEPT_RETRY_MILLISECONDS = 100;	// Wait after a failed accept, e.g. out of file descriptors
+	static const size_t MAX_REQUEST_BYTES = 64 * 1024;
+
+private:
+	string host;
+	int port;
+	int threads;
+	RenderCache cache;
+	const CantusFirmusLibrary* cantusLibrary = nullptr;
+	atomic<int> queuedConnections{0};	// Accepted but not yet picked up by a worker
+
+	void serveConnection(int connection);
+	static map<string, string> parseForm(const string& form);
+	static string decodeComponent(const string& component);
+	static bool parseJob(const map<string, string>& fields, GenerationJob& job, RngMode& mode, string& error);
+};
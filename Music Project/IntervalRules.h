@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include <cstdlib>
+using namespace std;
+
+// Interval and melodic rules the species engines share. Upper notes are offsets in scale steps above the lower note,
+// where 2 is a third and 7 an octave, and the lower note's own degree only matters when it is a leading tone
+
+// Scale degree within the octave, 0 for the tonic to 6 for the leading tone
+inline int degreeClass(int degree) {
+	return ((degree - 1) % 7 + 7) % 7;
+}
+
+// Degree 7 in any octave: 0, 7, -7 and so on
+inline bool isLeadingTone(int note) {
+	return degreeClass(note) == 6;
+}
+
+// 3rds, 5ths, 6ths, octaves and 10ths, without the diminished 5th above a leading tone
+inline uint16_t consonances(bool leadingToneBelow) {
+	uint16_t offsets = (1u << 2) | (1u << 4) | (1u << 5) | (1u << 7) | (1u << 9);
+	return leadingToneBelow ? offsets & ~(1u << 4) : offsets;
+}
+
+inline bool isConsonant(bool leadingToneBelow, int offset) {
+	return consonances(leadingToneBelow) >> offset & 1;
+}
+
+inline bool isPerfect(bool leadingToneBelow, int offset) {
+	return (offset == 4 || offset == 7) && isConsonant(leadingToneBelow, offset);
+}
+
+// No repeated notes, sixths, sevenths or leaps past an octave
+inline bool moveAllowed(int move) {
+	int size = abs(move);
+	return size != 0 && (size <= 4 || size == 7);
+}
+
+// A leap of a fourth or more is followed by a step back, and two leaps don't go the same way
+inline bool leapProblem(int lastMove, int move) {
+	if (abs(lastMove) >= 3 && !(abs(move) == 1 && move * lastMove < 0)) return true;
+	return abs(lastMove) >= 2 && abs(move) >= 2 && move * lastMove > 0;
+}
@@ -79,9 +79,19 @@
 #include <string>
 #include <ctime>
 #include <cstring>
+#include <fstream>
 #include "ExportToFile.h"
 #include "WritePhrase.h"
 #include "HelperFunctions.h"
+#include "Batch.h"
+#include "HttpServer.h"
+#include "PieceSpec.h"
+#include "MusicTables.h"
+#include "GenerateLowerVoice.h"
+#include "SpeciesOneEnumerator.h"
+#include "SpeciesOneVoices.h"
+#include "CantusFirmusLibrary.h"
+#include <memory>
 
 using namespace std;
 
@@ -95,8 +105,350 @@ string getArg(int argc, char* argv[], const string& name) {
 	return "";
 }
 
+// Check for a flag that takes no value
+bool hasFlag(int argc, char* argv[], const string& name) {
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == name) {
+			return true;
+		}
+	}
+	return false;
+}
+
+// Parses --beam-width, --beam-ms and --beam-threads for --engine beam, throws runtime_error for a bad value
+BeamOptions getBeamOptions(int argc, char* argv[]) {
+	BeamOptions beam;
+	string widthArg = getArg(argc, argv, "--beam-width");
+	string budgetArg = getArg(argc, argv, "--beam-ms");
+	string threadsArg = getArg(argc, argv, "--beam-threads");
+	try {
+		if (!widthArg.empty()) beam.width = stoi(widthArg);
+		if (!budgetArg.empty()) beam.timeBudgetMs = stod(budgetArg);
+		if (!threadsArg.empty()) beam.threads = stoi(threadsArg);
+	}
+	catch (logic_error&) {
+		throw runtime_error("--beam-width, --beam-ms and --beam-threads take numbers");
+	}
+	if (beam.width < 1 || beam.timeBudgetMs < 0 || beam.threads < 0) {
+		throw runtime_error("--beam-width must be at least 1, --beam-ms and --beam-threads at least 0");
+	}
+	return beam;
+}
+
+// Parses --voices, 2 unless given. Throws runtime_error for a bad value
+int getVoices(int argc, char* argv[]) {
+	string voicesArg = getArg(argc, argv, "--voices");
+	if (voicesArg.empty()) return 2;
+	int voices;
+	try {
+		voices = stoi(voicesArg);
+	}
+	catch (logic_error&) {
+		throw runtime_error("--voices takes a number");
+	}
+	if (voices < 2 || voices > SpeciesOneVoices::MAX_VOICES) {
+		throw runtime_error("--voices must be 2-" + to_string(SpeciesOneVoices::MAX_VOICES));
+	}
+	return voices;
+}
+
+// Parses --lower-voice walk|cantus and --cantus-library FILE, which implies cantus and is opened into library.
+// Throws runtime_error for an unknown source or a bad library
+LowerVoiceSource getLowerVoice(int argc, char* argv[], unique_ptr<CantusFirmusLibrary>& library) {
+	string lowerArg = getArg(argc, argv, "--lower-voice");
+	string libraryArg = getArg(argc, argv, "--cantus-library");
+	LowerVoiceSource source = lowerArg.empty() ? Lower_Walk : parseLowerVoice(lowerArg);
+	if (!libraryArg.empty()) {
+		library = make_unique<CantusFirmusLibrary>(libraryArg);
+		source = Lower_Cantus;
+	}
+	return source;
+}
+
+// Library mode: pre-generates validated cantus firmi for the given lengths, see CantusFirmusLibrary.h
+int runBuildLibraryMode(int argc, char* argv[]) {
+	string fileArg = getArg(argc, argv, "--build-cantus-library");
+	string lengthsArg = getArg(argc, argv, "--lengths");
+	string countArg = getArg(argc, argv, "--count");
+	string seedArg = getArg(argc, argv, "--seed");
+	if (fileArg.empty() || lengthsArg.empty()) {
+		cerr << "Usage: counterpoint --build-cantus-library FILE --lengths LIST [--count N] [--seed SEED]" << endl
+			<< "  Lengths are in notes (measures times beats), e.g. --lengths 8-32. --count is the most lines kept per length (1000)" << endl;
+		return 1;
+	}
+	vector<int> lengths = parseInts(lengthsArg);
+	int perLength = countArg.empty() ? 1000 : stoi(countArg);
+	uint32_t seed = seedArg.empty() ? 0 : static_cast<uint32_t>(stoll(seedArg));
+	vector<int> counts = CantusFirmusLibrary::build(fileArg, lengths, perLength, seed);
+	for (size_t i = 0; i < lengths.size(); i++) {
+		cout << lengths[i] << " notes: " << counts[i] << " cantus firmi" << endl;
+	}
+	cout << "Library written to " << fileArg << endl;
+	return 0;
+}
+
+// Parses --rng, returns false for an unknown mode
+bool getRngMode(int argc, char* argv[], RngMode& mode) {
+	string rngArg = getArg(argc, argv, "--rng");
+	if (rngArg.empty() || rngArg == "stream") {
+		mode = Rng_Stream;
+	}
+	else if (rngArg == "counter") {
+		mode = Rng_Counter;
+	}
+	else {
+		cerr << "Unknown --rng mode: " << rngArg << endl;
+		return false;
+	}
+	return true;
+}
+
+// Batch mode: every combination of the parameter lists (or the jobs in a job file) generated in this process
+int runBatchMode(int argc, char* argv[]) {
+	string jobsArg = getArg(argc, argv, "--jobs");
+	string outputArg = getArg(argc, argv, "--output");
+	string outputDirArg = getArg(argc, argv, "--output-dir");
+	string threadsArg = getArg(argc, argv, "--threads");
+	int threads = threadsArg.empty() ? 0 : stoi(threadsArg);
+	RngMode mode;
+	if (!getRngMode(argc, argv, mode)) return 1;
+
+	vector<GenerationJob> jobs;
+	if (!jobsArg.empty()) {
+		jobs = readJobFile(jobsArg);
+	}
+	else {
+		string seedsArg = getArg(argc, argv, "--seeds");
+		string keysArg = getArg(argc, argv, "--keys");
+		string speciesArg = getArg(argc, argv, "--species");
+		string measuresArg = getArg(argc, argv, "--measures");
+		string beatsArg = getArg(argc, argv, "--beats");
+		if (seedsArg.empty() || keysArg.empty() || speciesArg.empty() || measuresArg.empty() || beatsArg.empty()) {
+			outputArg.clear();
+			outputDirArg.clear();
+		}
+		else {
+			jobs = expandJobs(parseSeeds(seedsArg), parseList(keysArg), parseInts(speciesArg), parseInts(measuresArg), parseInts(beatsArg));
+		}
+	}
+	string engineArg = getArg(argc, argv, "--engine");
+	if (!engineArg.empty()) {
+		SpeciesOneEngine engine = parseEngine(engineArg);
+		for (auto& job : jobs) job.engine = engine;
+	}
+	BeamOptions beam = getBeamOptions(argc, argv);
+	unique_ptr<CantusFirmusLibrary> library;
+	LowerVoiceSource lowerVoice = getLowerVoice(argc, argv, library);
+	string twoArg = getArg(argc, argv, "--species-two");
+	SpeciesTwoEngine speciesTwo = twoArg.empty() ? Two_Rules : parseSpeciesTwo(twoArg);
+	int voices = getVoices(argc, argv);
+	for (auto& job : jobs) {
+		job.beam = beam;
+		job.lowerVoice = lowerVoice;
+		job.speciesTwo = speciesTwo;
+		job.voices = voices;
+		job.library = library.get();
+	}
+	if (outputArg.empty() == outputDirArg.empty()) {
+		cerr << "Usage: counterpoint --batch (--jobs FILE | --seeds LIST --keys LIST --species LIST --measures LIST --beats LIST)" << endl
+			<< "                    (--output FILE | --output-dir DIR) [--rng stream|counter] [--engine ENGINE] [--threads N]" << endl
+			<< "                    [--beam-width N] [--beam-ms MS] [--beam-threads N] [--lower-voice walk|cantus] [--cantus-library FILE]" << endl
+			<< "                    [--species-two rules|derived] [--voices N]" << endl
+			<< "  Lists are comma separated, numbers may be ranges (--seeds 1-100,500). Job file lines hold the same five fields." << endl
+			<< "  --output writes every job to one file, each preceded by a \"%%% Job N: ...\" line" << endl
+			<< "  --threads defaults to one per core, results are written in job order either way" << endl;
+		return 1;
+	}
+
+	ofstream multiplexed;
+	if (!outputArg.empty()) {
+		multiplexed.open(outputArg);
+		if (!multiplexed) throw runtime_error("Couldn't open file for output!");
+	}
+
+	int failed = 0;
+	double totalMilliseconds = 0;
+	runBatch(jobs, mode, [&](const JobResult& result) {
+		totalMilliseconds += result.milliseconds;
+		cout << "Job " << result.index + 1 << " (" << describeJob(result.job) << "): ";
+		if (!result.error.empty()) {
+			failed++;
+			cout << "FAILED: " << result.error << endl;
+			return;
+		}
+		cout << result.milliseconds << " ms" << endl;
+
+		if (multiplexed.is_open()) {
+			multiplexed << "%%% Job " << result.index + 1 << ": " << describeJob(result.job) << endl << result.output;
+		}
+		else {
+			const GenerationJob& job = result.job;
+			string fileName = outputDirArg + "/" + to_string(result.index + 1) + "_" + to_string(job.seed) + "_" + job.key + "_"
+				+ to_string(job.species) + "_" + to_string(job.measures) + "_" + to_string(job.beats) + ".txt";
+			ofstream jobFile(fileName);
+			if (!jobFile) throw runtime_error("Couldn't open file for output: " + fileName);
+			jobFile << result.output;
+		}
+	}, threads);
+
+	cout << jobs.size() << " jobs, " << failed << " failed, " << totalMilliseconds << " ms generating, "
+		<< WritePhrase::getTotalBacktrackStats().backtracks << " notes backtracked" << endl;
+	return failed == 0 ? 0 : 1;
+}
+
+// Enumerate mode: every first species upper voice for one lower voice, given with --lower or generated as --seed would
+int runEnumerateMode(int argc, char* argv[]) {
+	string lowerArg = getArg(argc, argv, "--lower");
+	string seedArg = getArg(argc, argv, "--seed");
+	string measuresArg = getArg(argc, argv, "--measures");
+	string beatsArg = getArg(argc, argv, "--beats");
+	string outputArg = getArg(argc, argv, "--output");
+	string limitArg = getArg(argc, argv, "--limit");
+	if (lowerArg.empty() == seedArg.empty() || (!seedArg.empty() && (measuresArg.empty() || beatsArg.empty()))) {
+		cerr << "Usage: counterpoint --enumerate (--lower DEGREES | --seed SEED --measures N --beats N [--rng stream|counter])" << endl
+			<< "                        [--count] [--limit N] [--output FILE]" << endl
+			<< "  --lower takes comma separated scale degrees, e.g. 1,3,2,4,3,2,1" << endl
+			<< "  --count prints only how many upper voices there are. Otherwise each is written on its own line as one digit" << endl
+			<< "  per note, the steps above the lower voice (1 a second ... 8 a ninth)" << endl;
+		return 1;
+	}
+
+	vector<int> lowerVoice;
+	if (!lowerArg.empty()) {
+		for (const auto& degree : parseList(lowerArg)) {
+			try {
+				lowerVoice.push_back(stoi(degree));
+			}
+			catch (logic_error&) {
+				throw runtime_error("Invalid scale degree: " + degree);
+			}
+		}
+	}
+	else {
+		// The same lower voice the single phrase CLI writes for species 1
+		RngMode mode;
+		if (!getRngMode(argc, argv, mode)) return 1;
+		uint32_t seed = static_cast<uint32_t>(stoll(seedArg));
+		Xorshift32 rng = mode == Rng_Counter ? Xorshift32::counterBased(seed, 0, 0) : Xorshift32(seed);
+		GenerateLowerVoice lower(rng, stoi(measuresArg) * stoi(beatsArg));
+		lowerVoice.assign(lower.getLowerVoice().begin(), lower.getLowerVoice().end());
+	}
+
+	SpeciesOneEnumerator enumerator(lowerVoice);
+	if (hasFlag(argc, argv, "--count")) {
+		cout << enumerator.count().toString() << endl;
+		return 0;
+	}
+
+	ofstream outputFile;
+	if (!outputArg.empty()) {
+		outputFile.open(outputArg);
+		if (!outputFile) throw runtime_error("Couldn't open file for output!");
+	}
+	ostream& output = outputArg.empty() ? cout : outputFile;
+	uint64_t limit = limitArg.empty() ? UINT64_MAX : stoull(limitArg);
+
+	output << "# lower:";
+	for (auto degree : lowerVoice) output << " " << degree;
+	output << "\n# " << enumerator.count().toString() << " upper voices\n";
+	string line(lowerVoice.size(), ' ');
+	uint64_t written = limit == 0 ? 0 : enumerator.enumerate([&](const vector<int>& upperVoice) {
+		for (size_t i = 0; i < upperVoice.size(); i++) {
+			line[i] = static_cast<char>('0' + upperVoice[i] - lowerVoice[i]);
+		}
+		output << line << '\n';
+		return --limit > 0;
+	});
+	output.flush();
+	if (!outputArg.empty()) cout << written << " upper voices written to " << outputArg << endl;
+	return 0;
+}
+
 int main(int argc, char* argv[]) {
 
+	// Prints the key and note name tables as JSON, for checking them against the TS port
+	if (hasFlag(argc, argv, "--dump-tables")) {
+		writeMusicTables(cout);
+		return 0;
+	}
+
+	if (hasFlag(argc, argv, "--build-cantus-library")) {
+		try {
+			return runBuildLibraryMode(argc, argv);
+		}
+		catch (runtime_error& exception) {
+			cerr << exception.what() << endl;
+			return 1;
+		}
+		catch (logic_error&) {	// stoi and friends
+			cerr << "Invalid number in the arguments" << endl;
+			return 1;
+		}
+	}
+
+	// Server mode: --serve [--host ADDRESS] [--port PORT] [--threads N] [--cache ENTRIES] [--cantus-library FILE], see HttpServer.h for the endpoints
+	if (hasFlag(argc, argv, "--serve")) {
+		string hostArg = getArg(argc, argv, "--host");
+		string portArg = getArg(argc, argv, "--port");
+		string threadsArg = getArg(argc, argv, "--threads");
+		string cacheArg = getArg(argc, argv, "--cache");
+		try {
+			HttpServer server(hostArg.empty() ? "127.0.0.1" : hostArg, portArg.empty() ? 8080 : stoi(portArg),
+				threadsArg.empty() ? 0 : stoi(threadsArg), cacheArg.empty() ? 1024 : stoul(cacheArg));
+			unique_ptr<CantusFirmusLibrary> library;
+			getLowerVoice(argc, argv, library);
+			server.setCantusLibrary(library.get());
+			server.run();
+		}
+		catch (exception& exception) {
+			cerr << exception.what() << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	// Spec file mode: a whole multi-phrase piece from --spec FILE, see PieceSpec.h for the format
+	string specArg = getArg(argc, argv, "--spec");
+	if (!specArg.empty()) {
+		try {
+			PieceSpec spec = readPieceSpec(specArg);
+			writePiece(spec);
+		}
+		catch (runtime_error& exception) {
+			cerr << exception.what() << endl;
+			return 1;
+		}
+		return 0;
+	}
+
+	if (hasFlag(argc, argv, "--enumerate")) {
+		try {
+			return runEnumerateMode(argc, argv);
+		}
+		catch (runtime_error& exception) {
+			cerr << exception.what() << endl;
+			return 1;
+		}
+		catch (logic_error&) {	// stoi and friends
+			cerr << "Invalid number in the arguments" << endl;
+			return 1;
+		}
+	}
+
+	if (hasFlag(argc, argv, "--batch")) {
+		try {
+			return runBatchMode(argc, argv);
+		}
+		catch (runtime_error& exception) {
+			cerr << exception.what() << endl;
+			return 1;
+		}
+		catch (logic_error&) {	// stoi and friends
+			cerr << "Invalid number in the arguments" << endl;
+			return 1;
+		}
+	}
+
 	// Non-interactive CLI mode: --seed, --key, --species, --measures, --beats, --output
 	string seedArg = getArg(argc, argv, "--seed");
 	if (!seedArg.empty()) {
@@ -107,32 +459,75 @@ int main(int argc, char* argv[]) {
 		string outputArg = getArg(argc, argv, "--output");
 
 		if (keyArg.empty() || speciesArg.empty() || measuresArg.empty() || beatsArg.empty() || outputArg.empty()) {
-			cerr << "Usage: counterpoint --seed SEED --key KEY --species SPECIES --measures N --beats N --output FILE" << endl;
+			cerr << "Usage: counterpoint --seed SEED --key KEY --species SPECIES --measures N --beats N --output FILE [--rng stream|counter]" << endl
+				<< "                    [--engine rules|table|composed|uniform|beam] [--beam-width N] [--beam-ms MS] [--beam-threads N]" << endl
+				<< "                    [--lower-voice walk|cantus] [--cantus-library FILE] [--species-two rules|derived] [--voices N]" << endl
+				<< "       counterpoint --spec FILE" << endl
+				<< "       counterpoint --batch ... (run with --batch alone for details)" << endl
+				<< "       counterpoint --enumerate ... (run with --enumerate alone for details)" << endl
+				<< "       counterpoint --serve [--host ADDRESS] [--port PORT] [--threads N] [--cache ENTRIES] [--cantus-library FILE]" << endl
+				<< "       counterpoint --build-cantus-library ... (run with --build-cantus-library alone for details)" << endl
+				<< "       counterpoint --dump-tables" << endl;
+			return 1;
+		}
+		RngMode mode;
+		if (!getRngMode(argc, argv, mode)) return 1;
+		string engineArg = getArg(argc, argv, "--engine");
+		SpeciesOneEngine engine = Engine_Table;
+		BeamOptions beam;
+		unique_ptr<CantusFirmusLibrary> library;
+		LowerVoiceSource lowerVoice;
+		string twoArg = getArg(argc, argv, "--species-two");
+		SpeciesTwoEngine speciesTwo = Two_Rules;
+		int voices;
+		try {
+			parseKey(keyArg);
+			if (!engineArg.empty()) engine = parseEngine(engineArg);
+			beam = getBeamOptions(argc, argv);
+			lowerVoice = getLowerVoice(argc, argv, library);
+			if (!twoArg.empty()) speciesTwo = parseSpeciesTwo(twoArg);
+			voices = getVoices(argc, argv);
+		}
+		catch (runtime_error& exception) {
+			cerr << exception.what() << endl;
 			return 1;
 		}
 
-		int seed = stoi(seedArg);
-		int species = stoi(speciesArg);
-		int measures = stoi(measuresArg);
-		int beats = stoi(beatsArg);
-
-		WritePhrase::setSeed(seed);
-
-		WritePhrase phrase(keyArg, measures, species, beats);
-		phrase.writeThePhrase();
+		GenerationJob job;
+		try {
+			job.seed = static_cast<uint32_t>(stoi(seedArg));
+			job.species = stoi(speciesArg);
+			job.measures = stoi(measuresArg);
+			job.beats = stoi(beatsArg);
+		}
+		catch (logic_error&) {	// stoi and friends
+			cerr << "Invalid number in the arguments" << endl;
+			return 1;
+		}
+		job.key = keyArg;
+		job.engine = engine;
+		job.beam = beam;
+		job.lowerVoice = lowerVoice;
+		job.speciesTwo = speciesTwo;
+		job.voices = voices;
+		job.library = library.get();
 
 		ExportToFile myFileExport;
-		myFileExport.addPhrase(phrase.getPhrase());
+		try {
+			generateJob(job, mode, myFileExport);
+		}
+		catch (runtime_error& exception) {
+			cerr << exception.what() << endl;
+			return 1;
+		}
 		myFileExport.forceSetFileName(outputArg);
-		myFileExport.setComposer("Comparison Test");
-		myFileExport.setTitle("Comparison Test");
 		myFileExport.WriteOutput();
 
 		return 0;
 	}
 
-	// Interactive mode (original behavior)
-	WritePhrase::setSeed(static_cast<unsigned>(time(0)));
+	// Interactive mode (original behavior) -- every phrase continues the same stream
+	Xorshift32 rng(static_cast<uint32_t>(time(0)));
 
 	int numPhrasesDesired;
 	string keyDesired;
@@ -151,13 +546,13 @@ int main(int argc, char* argv[]) {
 			cout << "Choose specifics for phrase " << to_string(i + 1) << ":" << endl;
 			cout << "	Options for Key: C, Db, D, Eb, E, F, F#, G, Ab, A, Bb, B" << endl;
 			getInput("	Enter the key you want phrase " + to_string(i + 1) + " to be in: ", keyDesired);
-			getInput("	Which species type would you like phrase " + to_string(i + 1) + " to be (0, 1 or 2): ", speciesTypeDesired);
+			getInput("	Which species type would you like phrase " + to_string(i + 1) + " to be (0, 1, 2, 3, 4 or 5): ", speciesTypeDesired);
 			getInput("	Enter how many measures you want phrase " + to_string(i + 1) + " to consist of: ", lengthDesired);
 			getInput("	Enter how many notes you want per measure for phrase " + to_string(i + 1) + ": ", beatsPerMeasureDesired);
 
-			WritePhrase phrase(keyDesired, lengthDesired, speciesTypeDesired, beatsPerMeasureDesired);
+			WritePhrase phrase(keyDesired, lengthDesired, speciesTypeDesired, beatsPerMeasureDesired, rng);
 			phrase.writeThePhrase();
-			myFileExport.addPhrase(phrase.getPhrase());
+			myFileExport.addPhrase(phrase.takePhrase());
 		}
 		getInput("Enter your desired output filename: ", fileNameDesired);
 		getInput("Enter the composer of this piece: ", authorInfoDesired);
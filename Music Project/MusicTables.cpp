@@ -0,0 +1,27 @@
+#include "MusicTables.h"
+#include <stdexcept>
+
+Key parseKey(string_view name) {
+	for (size_t i = 0; i < NUM_KEYS; i++) {
+		if (name == KEYS[i].name) return static_cast<Key>(i);
+	}
+	throw runtime_error("Unknown key: " + string(name) + " (use C, Db, D, Eb, E, F, F#, G, Ab, A, Bb or B)");
+}
+
+void writeMusicTables(ostream& output) {
+	output << "{\n\t\"scaleDegreeHalfSteps\": [";
+	for (size_t i = 0; i < 7; i++) {
+		output << (i ? ", " : "") << SCALE_DEGREE_HALF_STEPS[i];
+	}
+	output << "],\n\t\"keys\": [\n";
+	for (size_t i = 0; i < NUM_KEYS; i++) {
+		output << "\t\t{ \"name\": \"" << KEYS[i].name << "\", \"lilyPond\": \"" << KEYS[i].lilyPondName
+			<< "\", \"tonic\": " << KEYS[i].tonic << " }" << (i + 1 < NUM_KEYS ? "," : "") << "\n";
+	}
+	// Names contain ' and , but never " or \, so they need no escaping
+	output << "\t],\n\t\"noteNames\": [";
+	for (size_t i = 0; i < NUM_NOTES; i++) {
+		output << (i ? ", " : "") << "\"" << NOTE_NAMES[i] << "\"";
+	}
+	output << "]\n}\n";
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include "TypesAndGlobals.h"
+using namespace std;
+
+// Lookup tables for turning scale degrees into notes and notes into LilyPond, built at compile time.
+// The TS port mirrors the same mappings, writeMusicTables() prints them as JSON so the two can be compared.
+
+// Half steps above the tonic for scale degrees 1-7 of a major scale
+constexpr int SCALE_DEGREE_HALF_STEPS[7] = { 0, 2, 4, 5, 7, 9, 11 };
+
+// The keys the generator writes in, parsed once into a Key instead of comparing strings per note
+enum Key {
+	Key_C, Key_Db, Key_D, Key_Eb, Key_E, Key_F, Key_Fsharp, Key_G, Key_Ab, Key_A, Key_Bb, Key_B
+};
+constexpr size_t NUM_KEYS = 12;
+
+struct KeyInfo {
+	const char* name;			// As entered by the user
+	const char* lilyPondName;	// For \key ... \major
+	NoteType tonic;				// Scale degree 1
+};
+
+// Indexed by Key. Ab through B start below middle C, see the octave note in the README
+constexpr KeyInfo KEYS[NUM_KEYS] = {
+	{ "C", "c", Note_C4 },
+	{ "Db", "des", Note_D4_flat },
+	{ "D", "d", Note_D4 },
+	{ "Eb", "ees", Note_E4_flat },
+	{ "E", "e", Note_E4 },
+	{ "F", "f", Note_F4 },
+	{ "F#", "fis", Note_F4_sharp },
+	{ "G", "g", Note_G4 },
+	{ "Ab", "aes", Note_A3_flat },
+	{ "A", "a", Note_A3 },
+	{ "Bb", "bes", Note_B3_flat },
+	{ "B", "b", Note_B3 }
+};
+
+// LilyPond pitch for every NoteType, indexed by its value. Black keys are always spelled as sharps
+constexpr size_t NUM_NOTES = 88;
+constexpr const char* NOTE_NAMES[NUM_NOTES] = {
+	"a,,,", "ais,,,", "b,,,",
+	"c,,", "cis,,", "d,,", "dis,,", "e,,", "f,,", "fis,,", "g,,", "gis,,", "a,,", "ais,,", "b,,",
+	"c,", "cis,", "d,", "dis,", "e,", "f,", "fis,", "g,", "gis,", "a,", "ais,", "b,",
+	"c", "cis", "d", "dis", "e", "f", "fis", "g", "gis", "a", "ais", "b",
+	"c'", "cis'", "d'", "dis'", "e'", "f'", "fis'", "g'", "gis'", "a'", "ais'", "b'",
+	"c''", "cis''", "d''", "dis''", "e''", "f''", "fis''", "g''", "gis''", "a''", "ais''", "b''",
+	"c'''", "cis'''", "d'''", "dis'''", "e'''", "f'''", "fis'''", "g'''", "gis'''", "a'''", "ais'''", "b'''",
+	"c''''", "cis''''", "d''''", "dis''''", "e''''", "f''''", "fis''''", "g''''", "gis''''", "a''''", "ais''''", "b''''",
+	"c'''''"
+};
+
+// Throws runtime_error for a key not in KEYS
+Key parseKey(string_view name);
+
+/**
+ * @brief
+ * Half steps from the tonic to a scale degree, any octave. Degree 1 is the tonic, 8 the octave above, 0 the
+ * leading tone below
+ */
+constexpr int scaleDegreeToHalfStep(int scaleDegree) {
+	// Floor division so degrees below 1 land in the octaves below (matches TS Math.floor((scaleDegree - 1) / 7))
+	int fromTonic = scaleDegree - 1;
+	int octave = fromTonic >= 0 ? fromTonic / 7 : (fromTonic - 6) / 7;
+	return octave * 12 + SCALE_DEGREE_HALF_STEPS[fromTonic - octave * 7];
+}
+
+static_assert(scaleDegreeToHalfStep(1) == 0 && scaleDegreeToHalfStep(8) == 12 && scaleDegreeToHalfStep(0) == -1
+	&& scaleDegreeToHalfStep(-6) == -12, "scale degrees must wrap by octave");
+
+// Prints every table above as one JSON object, for parity checks against the TS port
+void writeMusicTables(ostream& output);
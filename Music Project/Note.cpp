@@ -1,6 +1,24 @@
 #include "Note.h"
+#include <stdexcept>
 
-Note::Note(NoteType note, int length) {
-	this->note = note;
-	this->length = length;
-}
\ No newline at end of file
+Note::Note(NoteType note, int length, bool tied, bool dotted) {
+	this->note = static_cast<uint8_t>(note);
+	this->length = static_cast<uint8_t>(length);
+	this->dotted = dotted;
+	this->tied = tied;
+}
+
+void Note::setEighths(int eighths) {
+	switch (eighths) {
+	case 8: case 4: case 2: case 1:
+		length = static_cast<uint8_t>(8 / eighths);
+		dotted = 0;
+		break;
+	case 6: case 3:
+		length = static_cast<uint8_t>(12 / eighths);
+		dotted = 1;
+		break;
+	default:
+		throw runtime_error("No single note lasts " + to_string(eighths) + " eighths");
+	}
+}
@@ -1,17 +1,30 @@
 #pragma once
+#include <cstdint>
 #include <ostream>
 #include <iostream>
 #include "TypesAndGlobals.h"
 using namespace std;
 
+// Four bytes, the NoteType (0-87), the length (1, 2, 4, 8 ...), whether it is dotted and whether it is tied into the
+// next note, so notes are stored by value
 class Note {
 public:
-	Note(NoteType note, int length = 4);
-	NoteType getNote() { return note; }
-	int getLength() { return length; }
-	void setNote(NoteType note) { this->note = note; cout << "setNote used: " << note << endl; }
-	void setLength(int length) { this->length = length; }
+	Note(NoteType note = Note_C4, int length = 4, bool tied = false, bool dotted = false);
+	NoteType getNote() const { return static_cast<NoteType>(note); }
+	int getLength() const { return length; }
+	bool isTied() const { return tied != 0; }
+	bool isDotted() const { return dotted != 0; }
+	// The duration in eighth notes, dots included (a dotted half is 6)
+	int getEighths() const { return 8 / length * (dotted ? 3 : 2) / 2; }
+	void setNote(NoteType note) { this->note = static_cast<uint8_t>(note); cout << "setNote used: " << note << endl; }
+	void setLength(int length) { this->length = static_cast<uint8_t>(length); }
+	void setTied(bool tied) { this->tied = tied; }
+	void setDotted(bool dotted) { this->dotted = dotted; }
+	// Sets the length and dot for a duration of 1 to 8 eighth notes, throws runtime_error for 5 and 7, which need a tie
+	void setEighths(int eighths);
 private:
-	NoteType note = Note_C4;
-	int length = 4;
+	uint8_t note = Note_C4;
+	uint8_t length = 4;
+	uint8_t dotted = 0;
+	uint8_t tied = 0;
 };
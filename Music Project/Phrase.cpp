@@ -1,6 +1,13 @@
 #include "Phrase.h"
 
-Phrase::Phrase(vector<Note*> upperVoice, vector<Note*> lowerVoice, string key, string timeSignature) : upperVoice(upperVoice), lowerVoice(lowerVoice) {
+Voice::Voice(const vector<Note>& notes) {
+	reserve(notes.size());
+	for (auto note : notes) {
+		push_back(note);
+	}
+}
+
+Phrase::Phrase(const vector<Note>& upperVoice, const vector<Note>& lowerVoice, string key, string timeSignature) : voices{ Voice(upperVoice), Voice(lowerVoice) } {
 	// Verify and assign key
 	this->key = verifyKey(key);
 
@@ -8,6 +15,18 @@ Phrase::Phrase(vector<Note*> upperVoice, vector<Note*> lowerVoice, string key, s
 	this->timeSignature = timeSignature;
 }
 
+Phrase::Phrase(const Voice& upperVoice, const Voice& lowerVoice, string key, string timeSignature) : voices{ upperVoice, lowerVoice } {
+	this->key = verifyKey(key);
+	this->timeSignature = timeSignature;
+}
+
+void Phrase::setVoiceCount(int count) {
+	if (count < 2) throw runtime_error("A phrase needs at least two voices, not " + to_string(count));
+	// Inner voices go in just above the lower one
+	while (getVoiceCount() < count) voices.insert(voices.end() - 1, Voice());
+	while (getVoiceCount() > count) voices.erase(voices.end() - 2);
+}
+
 void Phrase::setKey(string key) {
 	// Verify and assign key
 	this->key = verifyKey(key);
@@ -4,26 +4,57 @@
 
 using namespace std;
 
+// One voice, kept as parallel arrays of packed pitches, lengths, dots and ties so walking it reads small contiguous buffers
+class Voice {
+public:
+	Voice(const vector<Note>& notes = {});
+	void push_back(Note note) {
+		pitches.push_back(static_cast<uint8_t>(note.getNote()));
+		lengths.push_back(static_cast<uint8_t>(note.getLength()));
+		dots.push_back(note.isDotted());
+		ties.push_back(note.isTied());
+	}
+	void reserve(size_t count) { pitches.reserve(count); lengths.reserve(count); dots.reserve(count); ties.reserve(count); }
+	size_t size() const { return pitches.size(); }
+	Note at(size_t i) const { return Note(static_cast<NoteType>(pitches.at(i)), lengths.at(i), ties.at(i) != 0, dots.at(i) != 0); }
+	NoteType pitchAt(size_t i) const { return static_cast<NoteType>(pitches.at(i)); }
+	int lengthAt(size_t i) const { return lengths.at(i); }
+	const vector<uint8_t>& getPitches() const { return pitches; }
+	const vector<uint8_t>& getLengths() const { return lengths; }
+private:
+	vector<uint8_t> pitches;
+	vector<uint8_t> lengths;
+	vector<uint8_t> dots;
+	vector<uint8_t> ties;
+};
+
+// Its voices top first, two (upper and lower) unless setVoiceCount() adds inner voices between them
 class Phrase {
 public:
 	// Constructor
-	Phrase(vector<Note*> upperVoice = {}, vector<Note*> lowerVoice = {}, string key = "c", string timeSignature = "4/4");
+	Phrase(const vector<Note>& upperVoice = {}, const vector<Note>& lowerVoice = {}, string key = "c", string timeSignature = "4/4");
+	Phrase(const Voice& upperVoice, const Voice& lowerVoice, string key = "c", string timeSignature = "4/4");
 
 	// Mutators
-	void addNoteToUpperVoice(Note* note) { upperVoice.push_back(note); }
-	void addNoteToLowerVoice(Note* note) { lowerVoice.push_back(note); }
+	void addNoteToUpperVoice(Note note) { voices.front().push_back(note); }
+	void addNoteToLowerVoice(Note note) { voices.back().push_back(note); }
+	void addNoteToVoice(int voice, Note note) { voices.at(voice).push_back(note); }
+	// Adds or removes inner voices, keeping the upper and lower ones. Throws runtime_error for fewer than two
+	void setVoiceCount(int count);
+	void reserve(size_t notesPerVoice) { for (Voice& voice : voices) voice.reserve(notesPerVoice); }
 	void setKey(string key);
 	void setTimeSignature(string timeSignature);
 
 	// Accessors
-	vector<Note*> getUpperVoice() {	return upperVoice; }
-	vector<Note*> getLowerVoice() { return lowerVoice; }
-	string getTimeSig() { return timeSignature; }
-	string getKey() { return key; }
+	const Voice& getUpperVoice() const { return voices.front(); }
+	const Voice& getLowerVoice() const { return voices.back(); }
+	int getVoiceCount() const { return static_cast<int>(voices.size()); }
+	const Voice& getVoice(int voice) const { return voices.at(voice); }
+	const string& getTimeSig() const { return timeSignature; }
+	const string& getKey() const { return key; }
 
 private:
-	vector<Note*> upperVoice;
-	vector<Note*> lowerVoice;
+	vector<Voice> voices;
 	string key;
 	string timeSignature;
 
@@ -0,0 +1,130 @@
+#include "PieceSpec.h"
+#include "ExportToFile.h"
+#include "SpeciesOneVoices.h"
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+static string trim(const string& text) {
+	size_t first = text.find_first_not_of(" \t\r");
+	if (first == string::npos) return "";
+	size_t last = text.find_last_not_of(" \t\r");
+	return text.substr(first, last - first + 1);
+}
+
+// A # starts a comment at the start of a line or after whitespace, so keys like F# and titles keep theirs
+static string stripComment(const string& line) {
+	for (size_t i = 0; i < line.size(); i++) {
+		if (line[i] == '#' && (i == 0 || line[i - 1] == ' ' || line[i - 1] == '\t')) return line.substr(0, i);
+	}
+	return line;
+}
+
+PieceSpec readPieceSpec(const string& fileName) {
+	ifstream specFile(fileName);
+	if (!specFile) throw runtime_error("Couldn't open spec file: " + fileName);
+
+	PieceSpec spec;
+	vector<bool> phraseHasSeed;
+	vector<bool> phraseHasEngine;
+	string line;
+	int lineNumber = 0;
+	while (getline(specFile, line)) {
+		lineNumber++;
+		string where = fileName + ":" + to_string(lineNumber) + ": ";
+		line = trim(stripComment(line));
+		if (line.empty()) continue;
+
+		try {
+			if (line.compare(0, 7, "phrase ") == 0 || line == "phrase") {
+				// phrase key=C species=1 measures=4 beats=4 [seed=N] [engine=E] [voices=N]
+				GenerationJob phrase;
+				bool hasKey = false, hasSeed = false, hasEngine = false;
+				stringstream fields(line.substr(6));
+				string field;
+				while (fields >> field) {
+					size_t equals = field.find('=');
+					if (equals == string::npos) throw runtime_error("expected name=value, got \"" + field + "\"");
+					string name = field.substr(0, equals);
+					string value = field.substr(equals + 1);
+					if (name == "key") {
+						phrase.key = value;
+						hasKey = true;
+					}
+					else if (name == "species") phrase.species = stoi(value);
+					else if (name == "measures") phrase.measures = stoi(value);
+					else if (name == "beats") phrase.beats = stoi(value);
+					else if (name == "voices") {
+						phrase.voices = stoi(value);
+						if (phrase.voices < 2 || phrase.voices > SpeciesOneVoices::MAX_VOICES) {
+							throw runtime_error("voices must be 2-" + to_string(SpeciesOneVoices::MAX_VOICES));
+						}
+					}
+					else if (name == "seed") {
+						phrase.seed = static_cast<uint32_t>(stoll(value));
+						hasSeed = true;
+					}
+					else if (name == "engine") {
+						phrase.engine = parseEngine(value);
+						hasEngine = true;
+					}
+					else throw runtime_error("unknown phrase field \"" + name + "\"");
+				}
+				if (!hasKey) throw runtime_error("phrase needs a key");
+				checkMeter(phrase.species, phrase.beats);
+				spec.phrases.push_back(phrase);
+				phraseHasSeed.push_back(hasSeed);
+				phraseHasEngine.push_back(hasEngine);
+				continue;
+			}
+
+			// name = value
+			size_t equals = line.find('=');
+			if (equals == string::npos) throw runtime_error("expected \"name = value\" or a phrase line");
+			string name = trim(line.substr(0, equals));
+			string value = trim(line.substr(equals + 1));
+			if (name == "title") spec.title = value;
+			else if (name == "composer") spec.composer = value;
+			else if (name == "output") spec.output = value;
+			else if (name == "overwrite") {
+				if (value != "true" && value != "false") throw runtime_error("overwrite must be true or false");
+				spec.overwrite = value == "true";
+			}
+			else if (name == "seed") spec.seed = static_cast<uint32_t>(stoll(value));
+			else if (name == "engine") spec.engine = parseEngine(value);
+			else if (name == "rng") {
+				if (value == "stream") spec.mode = Rng_Stream;
+				else if (value == "counter") spec.mode = Rng_Counter;
+				else throw runtime_error("rng must be stream or counter");
+			}
+			else throw runtime_error("unknown setting \"" + name + "\"");
+		}
+		catch (runtime_error& exception) {
+			throw runtime_error(where + exception.what());
+		}
+		catch (logic_error&) {	// stoi/stoll
+			throw runtime_error(where + "invalid number");
+		}
+	}
+
+	if (spec.output.empty()) throw runtime_error(fileName + ": no output file given");
+	if (spec.phrases.empty()) throw runtime_error(fileName + ": no phrases given");
+	// The piece seed and engine may come after the phrases, so they are filled in last
+	for (size_t i = 0; i < spec.phrases.size(); i++) {
+		if (!phraseHasSeed.at(i)) spec.phrases.at(i).seed = Xorshift32::phraseSeed(spec.seed, static_cast<uint32_t>(i));
+		if (!phraseHasEngine.at(i)) spec.phrases.at(i).engine = spec.engine;
+	}
+	return spec;
+}
+
+void writePiece(const PieceSpec& spec) {
+	ExportToFile exporter;
+	// Checked before generating anything so a name clash fails fast
+	exporter.setFileName(spec.output, spec.overwrite);
+	for (const auto& phrase : spec.phrases) {
+		generateJob(phrase, spec.mode, exporter);
+	}
+	exporter.setTitle(spec.title);
+	exporter.setComposer(spec.composer);
+	exporter.WriteOutput();
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "Batch.h"
+#include <string>
+#include <vector>
+using namespace std;
+
+// A whole multi-phrase piece, read from a spec file instead of the interactive prompts in Main.cpp:
+//
+//   # Comments and blank lines are ignored, a # starts a comment at the start of a line or after a space
+//   title = Exercises in D and F#
+//   composer = Counterpoint Generator
+//   output = exercises.txt
+//   overwrite = true                  # Optional, without it an existing output file is an error
+//   seed = 12345                      # Optional, phrases without their own seed derive one from it
+//   rng = stream                      # Optional, stream or counter as with --rng
+//   engine = uniform                  # Optional, as with --engine, phrases may also set their own
+//   phrase key=D species=1 measures=4 beats=4 seed=7 engine=table
+//   phrase key=A species=0 measures=4 beats=4
+//   phrase key=D species=1 measures=4 beats=4 voices=4
+//   phrase key=F# species=1 measures=2 beats=4 seed=3
+//
+// A phrase with seed=S is the phrase the single phrase CLI writes for --seed S. One without a seed uses
+// Xorshift32::phraseSeed(seed, N) with N counting phrases from 0. voices=3 or 4 writes first species with inner
+// voices, and the score then has a staff for every voice, left empty in phrases without it.
+struct PieceSpec {
+	string title = "Untitled";
+	string composer = "Unknown";
+	string output;
+	bool overwrite = false;
+	uint32_t seed = 0;
+	RngMode mode = Rng_Stream;
+	SpeciesOneEngine engine = Engine_Table;
+	vector<GenerationJob> phrases;
+};
+
+// Throws runtime_error naming the file and line for anything it doesn't understand
+PieceSpec readPieceSpec(const string& fileName);
+
+/**
+ * @brief
+ * Generates every phrase of the piece and exports it in one pass, without reading stdin
+ *
+ * @pre
+ * spec.output is set and spec.phrases is not empty
+ */
+void writePiece(const PieceSpec& spec);
@@ -0,0 +1,45 @@
+#include "RenderCache.h"
+
+RenderCache::RenderCache(size_t capacity) : capacity(capacity) {
+}
+
+shared_ptr<const RenderedPhrase> RenderCache::get(const GenerationJob& job, RngMode mode) {
+	string key = makeKey(job, mode);
+	{
+		lock_guard<mutex> guard(lock);
+		auto found = index.find(key);
+		if (found != index.end()) {
+			stats.hits++;
+			entries.splice(entries.begin(), entries, found->second);
+			return found->second->second;
+		}
+		stats.misses++;
+	}
+
+	// Generate without holding the lock, two threads missing on the same key both generate the same text
+	auto rendered = make_shared<const RenderedPhrase>(renderPhrase(job, mode));
+	if (capacity == 0) return rendered;
+
+	lock_guard<mutex> guard(lock);
+	if (index.count(key)) return rendered;	// Someone else inserted it meanwhile
+	entries.emplace_front(key, rendered);
+	index[key] = entries.begin();
+	if (entries.size() > capacity) {
+		index.erase(entries.back().first);
+		entries.pop_back();
+		stats.evictions++;
+	}
+	return rendered;
+}
+
+RenderCache::Stats RenderCache::getStats() const {
+	lock_guard<mutex> guard(lock);
+	Stats current = stats;
+	current.size = entries.size();
+	current.capacity = capacity;
+	return current;
+}
+
+string RenderCache::makeKey(const GenerationJob& job, RngMode mode) {
+	return describeJob(job) + (mode == Rng_Counter ? " rng=counter" : " rng=stream");
+}
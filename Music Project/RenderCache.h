@@ -0,0 +1,40 @@
+#pragma once
+#include "Batch.h"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+using namespace std;
+
+// Bounded, thread-safe LRU cache of generated phrases. A job's output only depends on its parameters and RNG
+// mode, so a repeated request (a daily exercise seed, a shared link) is answered without generating again.
+// Entries are handed out as shared pointers, so one stays valid for its reader even after it has been evicted.
+class RenderCache {
+public:
+	// A capacity of 0 disables caching, every call generates
+	explicit RenderCache(size_t capacity = 1024);
+
+	// Cached phrase for the job, generated (outside the lock) and inserted on a miss. Throws what generation throws
+	shared_ptr<const RenderedPhrase> get(const GenerationJob& job, RngMode mode);
+
+	struct Stats {
+		uint64_t hits = 0;
+		uint64_t misses = 0;
+		uint64_t evictions = 0;
+		size_t size = 0;
+		size_t capacity = 0;
+	};
+	Stats getStats() const;
+
+private:
+	typedef pair<string, shared_ptr<const RenderedPhrase>> Entry;
+	size_t capacity;
+	list<Entry> entries;									// Most recently used first
+	unordered_map<string, list<Entry>::iterator> index;
+	mutable mutex lock;
+	Stats stats;
+
+	static string makeKey(const GenerationJob& job, RngMode mode);
+};
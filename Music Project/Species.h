@@ -1,5 +1,6 @@
 #pragma once
 #include "Note.h"
+#include "xorshift32.h"
 using namespace std;
 
 class Species
@@ -11,16 +12,21 @@ public:
 	void setNoteBelow(int noteBelow) { this->noteBelow = noteBelow; }
 	void setNoteBeforeAndBelow(int noteBeforeAndBelow) { this->noteBeforeAndBelow = noteBeforeAndBelow; }
 	void setNoteTwoBefore(int noteTwoBefore) { this->noteTwoBefore = noteTwoBefore; }
+	void setRng(Xorshift32& rng) { this->rng = &rng; }
+	void setPosition(int position) { this->position = position; }
 	int getNoteBefore() { return noteBefore; }
 	int getNoteBelow() { return noteBelow; }
 	int getNoteBeforeAndBelow() { return noteBeforeAndBelow; }
 	int getNoteTwoBefore() { return noteTwoBefore; }
+	int getPosition() { return position; }
 	
 protected:
 	int noteBefore;
 	int noteBelow;
 	int noteBeforeAndBelow;
 	int noteTwoBefore;
+	int position = 0;			// Index of the note being chosen in its voice
+	Xorshift32* rng = nullptr;	// Random stream of the phrase being written, owned by the caller
 
 	virtual int chooseNextNote() = 0;
 };
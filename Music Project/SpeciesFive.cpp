@@ -0,0 +1,420 @@
+#include "SpeciesFive.h"
+#include "IntervalRules.h"
+#include <cstdlib>
+#include <stdexcept>
+
+const int OFFSETS = SpeciesFive::OFFSET_COUNT;
+const int MOTIONS = 2 * SpeciesFive::MAX_MOTION + 1;
+const int MAX_NOTES = SpeciesFive::MAX_NOTES;
+const int MEASURE = 8;								// Eighth notes in a measure
+const int MAX_RHYTHMS = 16;
+const int OPENINGS = 2 * OFFSETS * OFFSETS;			// (held, downbeat, second note)
+const int OPENING_WORDS = (OPENINGS + 63) / 64;
+
+// How the last note of a figure leads into the next measure
+enum EndingKind {
+	End_Free,		// A consonance, anything the melodic rules allow can follow
+	End_Step,		// A dissonance or an eighth, so the next note is a step away
+	End_Tied		// A half held into the next measure
+};
+
+struct Rhythm {
+	uint8_t count = 0;
+	uint8_t eighths[MAX_NOTES] = {};
+	uint8_t held = 0;		// The first note is the one tied over from the last measure
+	uint8_t tiesOver = 0;	// The last note, a half on the third beat, is tied into the next measure
+	uint8_t weight = 0;
+};
+
+// One measure of the upper voice, in scale steps above its lower note
+struct FloridFigure {
+	uint8_t notes[MAX_NOTES];
+	uint8_t rhythm;
+	uint8_t weight;			// Steps are favoured over leaps
+	uint8_t dissonances;
+	uint8_t suspension;
+	uint16_t ending;
+};
+
+// A set of ways into the next measure, one bit per opening
+struct FloridOpenings {
+	uint64_t bits[OPENING_WORDS] = {};
+
+	bool has(int opening) const { return bits[opening / 64] >> (opening % 64) & 1; }
+	void set(int opening) { bits[opening / 64] |= uint64_t(1) << (opening % 64); }
+	void clear(int opening) { bits[opening / 64] &= ~(uint64_t(1) << (opening % 64)); }
+	bool meets(const FloridOpenings& other) const {
+		for (int word = 0; word < OPENING_WORDS; word++) {
+			if (bits[word] & other.bits[word]) return true;
+		}
+		return false;
+	}
+};
+
+static int opening(bool held, int downbeat, int second) {
+	return (held * OFFSETS + downbeat) * OFFSETS + second;
+}
+
+static int ending(int kind, int downbeat, int beforeLast, int last) {
+	return ((kind * OFFSETS + downbeat) * OFFSETS + beforeLast) * OFFSETS + last;
+}
+
+// Fills figure and returns true if the notes keep the rules inside the measure with this rhythm
+static bool makeFigure(bool leading, const Rhythm& rhythm, const int notes[], FloridFigure& figure) {
+	int moves[MAX_NOTES - 1];
+	int steps = 0;
+	for (int k = 1; k < rhythm.count; k++) {
+		moves[k - 1] = notes[k] - notes[k - 1];
+		if (!moveAllowed(moves[k - 1])) return false;
+		if (k >= 2 && leapProblem(moves[k - 2], moves[k - 1])) return false;
+		if (abs(moves[k - 1]) == 1) steps++;
+	}
+
+	bool mustStep = false;
+	int dissonances = 0;
+	bool suspension = false;
+	for (int k = 0, onset = 0; k < rhythm.count; onset += rhythm.eighths[k], k++) {
+		int length = rhythm.eighths[k];
+		bool last = k + 1 == rhythm.count;
+		// Eighths move by step, in and out. They never start a measure, so there is always a move in
+		if (length == 1) {
+			if (abs(moves[k - 1]) != 1) return false;
+			if (last) mustStep = true;
+			else if (abs(moves[k]) != 1) return false;
+		}
+		if (isConsonant(leading, notes[k])) continue;
+
+		if (k == 0 && rhythm.held) {
+			// A prepared 4-3, 7-6 or 9-8 suspension
+			if (!((notes[0] == 3 || notes[0] == 6 || notes[0] == 8) && moves[0] == -1 && isConsonant(leading, notes[1]))) return false;
+			suspension = true;
+			continue;
+		}
+		// Only short notes off the downbeat may be dissonant, and only when approached by step
+		if (onset == 0 || length >= 4 || abs(moves[k - 1]) != 1) return false;
+		dissonances++;
+		if (last) {
+			mustStep = true;
+			continue;
+		}
+		// Step down to the dissonance, a third down to a consonance, step up
+		bool cambiata = onset == 2 && length == 2 && moves[k - 1] == -1 && moves[k] == -2 && k + 2 < rhythm.count
+			&& rhythm.eighths[k + 1] == 2 && isConsonant(leading, notes[k + 1]) && moves[k + 1] == 1;
+		if (cambiata) continue;
+		if (abs(moves[k]) != 1) return false;
+		// Only passing tones on the third beat
+		if (onset == 4 && moves[k] != moves[k - 1]) return false;
+	}
+
+	for (int k = 0; k < MAX_NOTES; k++) figure.notes[k] = static_cast<uint8_t>(k < rhythm.count ? notes[k] : 0);
+	figure.weight = static_cast<uint8_t>(1 << steps);
+	figure.dissonances = static_cast<uint8_t>(dissonances);
+	figure.suspension = suspension;
+	int kind = rhythm.tiesOver ? End_Tied : mustStep ? End_Step : End_Free;
+	figure.ending = static_cast<uint16_t>(ending(kind, notes[0], notes[rhythm.count - 2], notes[rhythm.count - 1]));
+	return true;
+}
+
+struct FloridTable {
+	Rhythm rhythms[MAX_RHYTHMS];
+	int rhythmCount = 0;
+	// [leading tone below] every figure that keeps the rules inside its measure, by rhythm then opening
+	vector<FloridFigure> figures[2];
+	// figures[leading][starts[leading][rhythm][opening]] is the first with that rhythm and opening
+	uint32_t starts[2][MAX_RHYTHMS][OPENINGS + 1];
+	// The distinct endings of figures with each opening, from endingStarts[leading][opening], for the backward pass
+	vector<uint16_t> endingsByOpening[2];
+	uint32_t endingStarts[2][OPENINGS + 1];
+	// Every distinct ending
+	vector<uint16_t> endings[2];
+	// [ends with a dissonance or an eighth][note before last][last note][lower motion + MAX_MOTION] struck openings
+	// of the next measure that can follow, before fifths and octaves are checked
+	uint64_t crossings[2][OFFSETS][OFFSETS][MOTIONS][2];
+
+	FloridTable() {
+		Rhythm empty;
+		addRhythms(empty, 0, false);
+
+		for (int leading = 0; leading < 2; leading++) {
+			for (int r = 0; r < rhythmCount; r++) {
+				const Rhythm& rhythm = rhythms[r];
+				int combinations = 1;
+				for (int k = 0; k < rhythm.count; k++) combinations *= OFFSETS - 1;
+				for (int combination = 0; combination < combinations; combination++) {
+					int notes[MAX_NOTES];
+					for (int k = rhythm.count - 1, rest = combination; k >= 0; k--, rest /= OFFSETS - 1) notes[k] = 1 + rest % (OFFSETS - 1);
+					FloridFigure figure;
+					if (!makeFigure(leading, rhythm, notes, figure)) continue;
+					figure.rhythm = static_cast<uint8_t>(r);
+					figures[leading].push_back(figure);
+				}
+			}
+			index(leading);
+		}
+
+		for (int step = 0; step < 2; step++) {
+			for (int beforeLast = 1; beforeLast < OFFSETS; beforeLast++) {
+				for (int last = 1; last < OFFSETS; last++) {
+					for (int motion = -SpeciesFive::MAX_MOTION; motion <= SpeciesFive::MAX_MOTION; motion++) {
+						FloridOpenings next;
+						for (int downbeat = 1; downbeat < OFFSETS; downbeat++) {
+							int move = downbeat + motion - last;
+							if (!moveAllowed(move) || leapProblem(last - beforeLast, move) || (step && abs(move) != 1)) continue;
+							for (int second = 1; second < OFFSETS; second++) {
+								if (!leapProblem(move, second - downbeat)) next.set(opening(false, downbeat, second));
+							}
+						}
+						crossings[step][beforeLast][last][motion + SpeciesFive::MAX_MOTION][0] = next.bits[0];
+						crossings[step][beforeLast][last][motion + SpeciesFive::MAX_MOTION][1] = next.bits[1];
+					}
+				}
+			}
+		}
+	}
+
+	// Halves on the first or third beat but never after shorter notes, a dotted half on the first, quarters on any
+	// beat and one pair of eighths at most, on the second or fourth. Whole notes are left to the final
+	void addRhythms(Rhythm rhythm, int position, bool eighthsUsed) {
+		if (position == MEASURE) {
+			addVariants(rhythm);
+			return;
+		}
+		int previous = rhythm.count > 0 ? rhythm.eighths[rhythm.count - 1] : MEASURE;
+		for (int length : { 6, 4, 2, 1 }) {
+			if (position + length > MEASURE || rhythm.count + (length == 1 ? 2 : 1) > MAX_NOTES) continue;
+			if (length == 6 && position != 0) continue;
+			if (length == 4 && !(position == 0 || (position == 4 && previous >= 4))) continue;
+			if (length == 1 && (eighthsUsed || (position != 2 && position != 6))) continue;
+			Rhythm next = rhythm;
+			next.eighths[next.count++] = static_cast<uint8_t>(length);
+			if (length == 1) next.eighths[next.count++] = 1;
+			addRhythms(next, position + (length == 1 ? 2 : length), eighthsUsed || length == 1);
+		}
+	}
+
+	// Each rhythm as it is, starting with a held note when it starts with a half, and tied over when it ends with one
+	void addVariants(Rhythm rhythm) {
+		bool hasEighths = false;
+		for (int k = 0; k < rhythm.count; k++) hasEighths = hasEighths || rhythm.eighths[k] == 1;
+		rhythm.weight = hasEighths ? 1 : 2;
+		bool canHold = rhythm.eighths[0] == 4;
+		bool canTie = rhythm.eighths[rhythm.count - 1] == 4;
+		for (int held = 0; held <= canHold; held++) {
+			for (int tiesOver = 0; tiesOver <= canTie; tiesOver++) {
+				Rhythm variant = rhythm;
+				variant.held = static_cast<uint8_t>(held);
+				variant.tiesOver = static_cast<uint8_t>(tiesOver);
+				if (tiesOver) variant.weight = 3;
+				rhythms[rhythmCount++] = variant;
+			}
+		}
+	}
+
+	void index(int leading) {
+		const vector<FloridFigure>& list = figures[leading];
+		size_t f = 0;
+		for (int r = 0; r < MAX_RHYTHMS; r++) {
+			for (int o = 0; o <= OPENINGS; o++) {
+				while (f < list.size() && list[f].rhythm == r && opening(rhythms[r].held, list[f].notes[0], list[f].notes[1]) < o) f++;
+				starts[leading][r][o] = static_cast<uint32_t>(f);
+			}
+		}
+
+		vector<uint64_t> byOpening(static_cast<size_t>(OPENINGS) * SpeciesFive::ENDING_WORDS, 0);
+		vector<uint64_t> all(SpeciesFive::ENDING_WORDS, 0);
+		for (const FloridFigure& figure : list) {
+			int o = opening(rhythms[figure.rhythm].held, figure.notes[0], figure.notes[1]);
+			byOpening[o * SpeciesFive::ENDING_WORDS + figure.ending / 64] |= uint64_t(1) << (figure.ending % 64);
+			all[figure.ending / 64] |= uint64_t(1) << (figure.ending % 64);
+		}
+		for (int o = 0; o < OPENINGS; o++) {
+			endingStarts[leading][o] = static_cast<uint32_t>(endingsByOpening[leading].size());
+			for (int e = 0; e < SpeciesFive::ENDING_COUNT; e++) {
+				if (byOpening[o * SpeciesFive::ENDING_WORDS + e / 64] >> (e % 64) & 1) endingsByOpening[leading].push_back(static_cast<uint16_t>(e));
+			}
+		}
+		endingStarts[leading][OPENINGS] = static_cast<uint32_t>(endingsByOpening[leading].size());
+		for (int e = 0; e < SpeciesFive::ENDING_COUNT; e++) {
+			if (all[e / 64] >> (e % 64) & 1) endings[leading].push_back(static_cast<uint16_t>(e));
+		}
+	}
+};
+
+static const FloridTable& figureTable() {
+	static const FloridTable table;
+	return table;
+}
+
+// FloridOpenings that can follow a figure ending over a lower voice moving by motion
+static FloridOpenings follows(bool leading, int ending, int motion) {
+	int kind = ending / (OFFSETS * OFFSETS * OFFSETS);
+	int downbeat = ending / (OFFSETS * OFFSETS) % OFFSETS;
+	int beforeLast = ending / OFFSETS % OFFSETS;
+	int last = ending % OFFSETS;
+	FloridOpenings next;
+	if (kind == End_Tied) {
+		// The same note, now above the next lower note. The tie doesn't move, so the leap rules look past it
+		int held = last - motion;
+		for (int second = 1; held >= 1 && held < OFFSETS && second < OFFSETS; second++) {
+			if (!leapProblem(last - beforeLast, second - held)) next.set(opening(true, held, second));
+		}
+	}
+	else {
+		const uint64_t* struck = figureTable().crossings[kind == End_Step][beforeLast][last][motion + SpeciesFive::MAX_MOTION];
+		next.bits[0] = struck[0];
+		next.bits[1] = struck[1];
+		// A fifth or octave struck again on the downbeat
+		if (isPerfect(leading, last)) {
+			for (int second = 0; second < OFFSETS; second++) next.clear(opening(false, last, second));
+		}
+	}
+	// Fifths or octaves on both downbeats
+	if (isPerfect(leading, downbeat)) {
+		for (int second = 0; second < OFFSETS; second++) {
+			next.clear(opening(false, downbeat, second));
+			next.clear(opening(true, downbeat, second));
+		}
+	}
+	return next;
+}
+
+// Whether the figure ends a step below the final note without parallels into it
+static bool reachesFinal(bool leading, int ending, int cadence, int octave) {
+	int downbeat = ending / (OFFSETS * OFFSETS) % OFFSETS;
+	int beforeLast = ending / OFFSETS % OFFSETS;
+	int last = ending % OFFSETS;
+	if (ending / (OFFSETS * OFFSETS * OFFSETS) == End_Tied || last != cadence || leapProblem(last - beforeLast, 1)) return false;
+	return !(isPerfect(leading, last) && octave == last) && !(isPerfect(leading, downbeat) && octave == downbeat);
+}
+
+// Downbeats of the first measure, a fifth or octave above the tonic
+static FloridOpenings starts(int lowerNote) {
+	FloridOpenings first;
+	for (int note : { 5, 8 }) {
+		int downbeat = note - lowerNote;
+		if (downbeat < 1 || downbeat >= OFFSETS || !isPerfect(isLeadingTone(lowerNote), downbeat)) continue;
+		for (int second = 1; second < OFFSETS; second++) first.set(opening(false, downbeat, second));
+	}
+	return first;
+}
+
+SpeciesFive::SpeciesFive(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch) : lower(lowerVoice), viable(scratch) {
+	int length = static_cast<int>(lower.size());
+	if (length < 2) throw runtime_error("The lower voice is too short for a cadence");
+	for (int i = 1; i < length; i++) {
+		if (abs(lower[i] - lower[i - 1]) > MAX_MOTION) throw runtime_error("The lower voice leaps too far for fifth species");
+	}
+	const FloridTable& table = figureTable();
+
+	// The leading tone last before the octave
+	int cadence = 7 - lower[length - 2];
+	int octave = 8 - lower[length - 1];
+	if (cadence < 1 || cadence >= OFFSETS || octave < 1 || octave >= OFFSETS || !isConsonant(isLeadingTone(lower[length - 1]), octave)) {
+		throw runtime_error("No fifth species cadence fits this lower voice");
+	}
+	viable.assign((length - 1) * ENDING_WORDS, 0);
+	bool leading = isLeadingTone(lower[length - 2]);
+	for (uint16_t ending : table.endings[leading]) {
+		if (reachesFinal(leading, ending, cadence, octave)) markViable(length - 2, ending);
+	}
+
+	// Whether some figure with this opening ends viably in the measure
+	auto opens = [&](int measure, int opening) {
+		bool leadingHere = isLeadingTone(lower[measure]);
+		for (uint32_t j = table.endingStarts[leadingHere][opening]; j < table.endingStarts[leadingHere][opening + 1]; j++) {
+			if (isViable(measure, table.endingsByOpening[leadingHere][j])) return true;
+		}
+		return false;
+	};
+	for (int i = length - 3; i >= 0; i--) {
+		FloridOpenings next;
+		for (int o = 0; o < OPENINGS; o++) {
+			if (opens(i + 1, o)) next.set(o);
+		}
+		leading = isLeadingTone(lower[i]);
+		for (uint16_t ending : table.endings[leading]) {
+			if (follows(leading, ending, lower[i + 1] - lower[i]).meets(next)) markViable(i, ending);
+		}
+	}
+
+	FloridOpenings first = starts(lower[0]);
+	for (int o = 0; o < OPENINGS; o++) {
+		if (first.has(o) && opens(0, o)) return;
+	}
+	throw runtime_error("No fifth species upper voice fits this lower voice");
+}
+
+void SpeciesFive::write(Xorshift32& rng, pmr::vector<int>& upperVoice, pmr::vector<uint8_t>& eighths, pmr::vector<uint8_t>& tied) {
+	const FloridTable& table = figureTable();
+	int length = static_cast<int>(lower.size());
+	size_t most = MAX_NOTES * (length - 1) + 1;
+	upperVoice.reserve(upperVoice.size() + most);
+	eighths.reserve(eighths.size() + most);
+	tied.reserve(tied.size() + most);
+	suspensions = 0;
+	dissonances = 0;
+
+	int previousEnding = 0;
+	int previousRhythm = -1;
+	for (int i = 0; i + 1 < length; i++) {
+		rng.setPosition(i);
+		bool leading = isLeadingTone(lower[i]);
+		const vector<FloridFigure>& figures = table.figures[leading];
+		FloridOpenings allowed = i == 0 ? starts(lower[0]) : follows(isLeadingTone(lower[i - 1]), previousEnding, lower[i] - lower[i - 1]);
+		// Calls visit with every figure of the rhythm that can follow and go on, until it returns true
+		auto eachFigure = [&](int rhythm, auto visit) {
+			for (int o = 0; o < OPENINGS; o++) {
+				if (!allowed.has(o)) continue;
+				for (uint32_t f = table.starts[leading][rhythm][o]; f < table.starts[leading][rhythm][o + 1]; f++) {
+					if (isViable(i, figures[f].ending) && visit(figures[f])) return;
+				}
+			}
+		};
+
+		// The rhythm first, from the ones with a figure that can go on. The same rhythm twice running counts half
+		double weights[MAX_RHYTHMS] = {};
+		double total = 0;
+		for (int r = 0; r < table.rhythmCount; r++) {
+			bool possible = false;
+			eachFigure(r, [&](const FloridFigure&) { return possible = true; });
+			if (!possible) continue;
+			weights[r] = table.rhythms[r].weight * (r == previousRhythm ? 0.5 : 1.0);
+			total += weights[r];
+		}
+		double target = rng.nextFloat() * total;
+		int rhythm = 0;
+		for (int r = 0; r < table.rhythmCount; r++) {
+			if (weights[r] == 0) continue;
+			rhythm = r;		// The last option catches rounding at the top end
+			if (target < weights[r]) break;
+			target -= weights[r];
+		}
+
+		// Then the pitches, weighed and drawn from in the same order
+		total = 0;
+		eachFigure(rhythm, [&](const FloridFigure& figure) { total += figure.weight; return false; });
+		target = rng.nextFloat() * total;
+		const FloridFigure* chosen = nullptr;
+		eachFigure(rhythm, [&](const FloridFigure& figure) {
+			chosen = &figure;
+			if (target < figure.weight) return true;
+			target -= figure.weight;
+			return false;
+		});
+
+		const Rhythm& notes = table.rhythms[rhythm];
+		for (int k = 0; k < notes.count; k++) {
+			upperVoice.push_back(lower[i] + chosen->notes[k]);
+			eighths.push_back(notes.eighths[k]);
+			tied.push_back(k + 1 == notes.count && notes.tiesOver);
+		}
+		suspensions += chosen->suspension;
+		dissonances += chosen->dissonances;
+		previousEnding = chosen->ending;
+		previousRhythm = rhythm;
+	}
+
+	upperVoice.push_back(8);
+	eighths.push_back(MEASURE);
+	tied.push_back(0);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief
+ * Fifth (florid) species: an upper voice mixing the rhythms of the other species against a whole note lower voice.
+ *
+ * Each measure takes a rhythm from a library of the ones the style allows, worked out once on first use: halves on
+ * the first or third beat (never a half after shorter notes), a dotted half and a quarter, quarters, and at most one
+ * pair of eighths on the second or fourth beat. A half on the third beat may be tied into the next measure, which then
+ * starts with the held note. Pitches keep every rule of the earlier species together: consonant downbeats and long
+ * notes, weak beat dissonances as passing or neighbour tones or in a cambiata, held notes either consonant or
+ * prepared 7-6, 4-3 and 9-8 suspensions resolving down by step, eighths moving by step, recovered leaps, no fifths or
+ * octaves on successive downbeats or across the bar line, and the leading tone into the final octave.
+ *
+ * As in SpeciesThree, every (rhythm, pitches) figure that keeps the rules inside its measure is listed once, and the
+ * constructor marks, last measure first, the figure endings that can still reach the cadence. write() then draws the
+ * rhythm from the ones that can go on and the pitches from that rhythm's figures, without allocating. It never
+ * dead-ends
+ */
+class SpeciesFive {
+public:
+	// Throws runtime_error if no upper voice fits the lower voice
+	SpeciesFive(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch = pmr::get_default_resource());
+
+	// Appends the notes of every lower note's measure but the last, then the final whole note. eighths gets each
+	// note's duration in eighth notes (see Note::setEighths) and tied a flag set when the note is held into the next.
+	// Two draws per lower note but the last, the rhythm then the pitches, at its position
+	void write(Xorshift32& rng, pmr::vector<int>& upperVoice, pmr::vector<uint8_t>& eighths, pmr::vector<uint8_t>& tied);
+
+	// Of the last write()
+	int getSuspensions() const { return suspensions; }
+	int getDissonances() const { return dissonances; }	// Passing and neighbour tones and cambiatas
+
+	static const int OFFSET_COUNT = 10;		// Scale steps above the lower note, unison to a tenth
+	static const int MAX_MOTION = 12;		// Furthest the lower voice may move between notes, in scale steps
+	static const int MAX_NOTES = 5;			// Most notes in a measure, a quarter, two eighths and two quarters
+	static const int ENDING_COUNT = 3 * OFFSET_COUNT * OFFSET_COUNT * OFFSET_COUNT;
+	static const int ENDING_WORDS = (ENDING_COUNT + 63) / 64;
+
+private:
+	const pmr::vector<int>& lower;
+	// ENDING_WORDS words per measure, the figure endings that can still reach the cadence
+	pmr::vector<uint64_t> viable;
+	int suspensions = 0;
+	int dissonances = 0;
+
+	bool isViable(int measure, int ending) const { return viable[measure * ENDING_WORDS + ending / 64] >> (ending % 64) & 1; }
+	void markViable(int measure, int ending) { viable[measure * ENDING_WORDS + ending / 64] |= uint64_t(1) << (ending % 64); }
+};
@@ -0,0 +1,216 @@
+#include "SpeciesFour.h"
+#include "IntervalRules.h"
+#include <cstdlib>
+#include <stdexcept>
+
+enum TieKind {
+	Tie_Consonant,		// The held note is still consonant
+	Tie_Suspension,		// The held note is a 7th, 4th or 9th and resolves down by step
+	Tie_None			// The note can't be held
+};
+
+// What holding a weak beat note into the next strong beat does
+struct Syncopation {
+	uint8_t kind = Tie_None;
+	uint16_t weak = 0;			// Weak beat offsets the voice can go on to if the note is held
+	uint16_t breakStrong = 0;	// Strong beat offsets it can strike instead, breaking the species
+};
+
+const int MOTIONS = 2 * SpeciesFour::MAX_MOTION + 1;
+
+// A 5th or octave on one weak beat may not follow the same on the one before
+static uint16_t parallels(int weak) {
+	return weak == 4 || weak == 7 ? 1u << weak : 0;
+}
+
+struct SyncopationTable {
+	// [leading tone below the next note][weak offset][lower motion + MAX_MOTION]
+	Syncopation steps[2][SpeciesFour::OFFSET_COUNT][MOTIONS];
+	// [leading tone below][strong offset] weak beat offsets after a strong beat struck over the same lower note
+	uint16_t weakAfterStrong[2][SpeciesFour::OFFSET_COUNT];
+
+	SyncopationTable() {
+		for (int leading = 0; leading < 2; leading++) {
+			uint16_t consonant = consonances(leading);
+			for (int strong = 0; strong < SpeciesFour::OFFSET_COUNT; strong++) {
+				weakAfterStrong[leading][strong] = 0;
+				for (int weak = 1; weak < SpeciesFour::OFFSET_COUNT; weak++) {
+					if ((consonant & (1u << weak)) && moveAllowed(weak - strong)) weakAfterStrong[leading][strong] |= 1u << weak;
+				}
+			}
+
+			for (int weak = 0; weak < SpeciesFour::OFFSET_COUNT; weak++) {
+				for (int motion = -SpeciesFour::MAX_MOTION; motion <= SpeciesFour::MAX_MOTION; motion++) {
+					Syncopation& step = steps[leading][weak][motion + SpeciesFour::MAX_MOTION];
+					for (int strong = 1; strong < SpeciesFour::OFFSET_COUNT; strong++) {
+						// Struck again, the move is from the held note to the new one over the next lower note
+						if ((consonant & (1u << strong)) && moveAllowed(strong + motion - weak)) step.breakStrong |= 1u << strong;
+					}
+
+					int held = weak - motion;	// The tied note's offset above the next lower note
+					if (held < 1 || held >= SpeciesFour::OFFSET_COUNT) continue;
+					if (consonant & (1u << held)) {
+						step.kind = Tie_Consonant;
+						step.weak = weakAfterStrong[leading][held];
+					}
+					else if ((held == 6 || held == 3 || held == 8) && (consonant & (1u << (held - 1)))) {
+						// 7-6, 4-3 and 9-8
+						step.kind = Tie_Suspension;
+						step.weak = 1u << (held - 1);
+					}
+					step.weak &= ~parallels(weak);
+				}
+			}
+		}
+	}
+};
+
+static const SyncopationTable& syncopations() {
+	static const SyncopationTable table;
+	return table;
+}
+
+SpeciesFour::SpeciesFour(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch) : lower(lowerVoice), viable(scratch) {
+	int length = static_cast<int>(lower.size());
+	if (length < 3) throw runtime_error("The lower voice is too short for a cadence");
+	for (int i = 1; i < length; i++) {
+		if (abs(lower[i] - lower[i - 1]) > MAX_MOTION) throw runtime_error("The lower voice leaps too far for fourth species");
+	}
+	const SyncopationTable& table = syncopations();
+
+	// The leading tone on the last weak beat, then the octave
+	int cadence = 7 - lower[length - 2];
+	viable.assign(length - 1, 0);
+	if (cadence < 1 || cadence >= OFFSET_COUNT || !(consonances(isLeadingTone(lower[length - 2])) & (1u << cadence))) {
+		throw runtime_error("No fourth species cadence fits this lower voice");
+	}
+	viable[length - 2] = 1u << cadence;
+
+	for (int i = length - 3; i >= 0; i--) {
+		bool leadingNext = isLeadingTone(lower[i + 1]);
+		for (int weak = 1; weak < OFFSET_COUNT; weak++) {
+			if (!(consonances(isLeadingTone(lower[i])) & (1u << weak))) continue;
+			bool reaches = tieOptions(i, weak) != 0;
+			const Syncopation& step = table.steps[leadingNext][weak][lower[i + 1] - lower[i] + MAX_MOTION];
+			for (int strong = 1; !reaches && strong < OFFSET_COUNT; strong++) {
+				reaches = (step.breakStrong & (1u << strong))
+					&& (table.weakAfterStrong[leadingNext][strong] & ~parallels(weak) & viable[i + 1]);
+			}
+			if (reaches) viable[i] |= 1u << weak;
+		}
+	}
+
+	bool starts = false;
+	for (int note : { 5, 8 }) {
+		int offset = note - lower[0];
+		starts = starts || (offset >= 1 && offset < OFFSET_COUNT && (table.weakAfterStrong[isLeadingTone(lower[0])][offset] & viable[0]));
+	}
+	if (!starts) throw runtime_error("No fourth species upper voice fits this lower voice");
+}
+
+uint16_t SpeciesFour::tieOptions(int position, int weak) const {
+	const Syncopation& step = syncopations().steps[isLeadingTone(lower[position + 1])][weak][lower[position + 1] - lower[position] + MAX_MOTION];
+	return step.kind == Tie_None ? 0 : step.weak & viable[position + 1];
+}
+
+int SpeciesFour::pickWeak(int position, uint16_t options, Xorshift32& rng) const {
+	// Suspensions are the point, so weak beats that will be held into one are favoured, and ones that can't be held at
+	// all (breaking the species) only taken when nothing else is left
+	double weights[OFFSET_COUNT] = {};
+	double total = 0;
+	bool last = position + 1 >= static_cast<int>(lower.size()) - 1;
+	uint16_t holdable = 0;
+	for (int weak = 1; !last && weak < OFFSET_COUNT; weak++) {
+		if ((options & (1u << weak)) && tieOptions(position, weak) != 0) holdable |= 1u << weak;
+	}
+	if (holdable != 0) options = holdable;
+	for (int weak = 1; weak < OFFSET_COUNT; weak++) {
+		if (!(options & (1u << weak))) continue;
+		if (last || holdable == 0) {
+			weights[weak] = 1;
+		}
+		else {
+			bool suspends = syncopations().steps[isLeadingTone(lower[position + 1])][weak][lower[position + 1] - lower[position] + MAX_MOTION].kind == Tie_Suspension;
+			weights[weak] = suspends ? 4 : 1;
+		}
+		total += weights[weak];
+	}
+	double target = rng.nextFloat() * total;
+	int chosen = 0;
+	for (int weak = 1; weak < OFFSET_COUNT; weak++) {
+		if (weights[weak] == 0) continue;
+		chosen = weak;	// The last option catches rounding at the top end
+		if (target < weights[weak]) break;
+		target -= weights[weak];
+	}
+	return chosen;
+}
+
+void SpeciesFour::write(Xorshift32& rng, pmr::vector<int>& upperVoice, pmr::vector<uint8_t>& tied) {
+	const SyncopationTable& table = syncopations();
+	int length = static_cast<int>(lower.size());
+	upperVoice.reserve(upperVoice.size() + 2 * length - 1);
+	tied.reserve(tied.size() + 2 * length - 1);
+	suspensions = 0;
+	breaks = 0;
+
+	// 5 or 8 on the first strong beat, whichever can go on
+	rng.setPosition(0);
+	bool leading = isLeadingTone(lower[0]);
+	int starts[2];
+	int startCount = 0;
+	for (int note : { 5, 8 }) {
+		int offset = note - lower[0];
+		if (offset >= 1 && offset < OFFSET_COUNT && (table.weakAfterStrong[leading][offset] & viable[0])) starts[startCount++] = offset;
+	}
+	int strong = starts[rng.nextInt(startCount)];
+	int weak = pickWeak(0, table.weakAfterStrong[leading][strong] & viable[0], rng);
+	upperVoice.push_back(lower[0] + strong);
+	upperVoice.push_back(lower[0] + weak);
+	tied.push_back(0);
+	tied.push_back(0);
+
+	for (int i = 0; i + 2 < length; i++) {
+		rng.setPosition(i + 1);
+		uint16_t held = tieOptions(i, weak);
+		int next;
+		if (held != 0) {
+			tied.back() = 1;
+			strong = weak - (lower[i + 1] - lower[i]);
+			if (table.steps[isLeadingTone(lower[i + 1])][weak][lower[i + 1] - lower[i] + MAX_MOTION].kind == Tie_Suspension) suspensions++;
+			next = pickWeak(i + 1, held, rng);
+		}
+		else {
+			// Break the species: every (strong, weak) pair that can go on is equally likely, as long as the weak beat can
+			// be held again if any can
+			bool leadingNext = isLeadingTone(lower[i + 1]);
+			const Syncopation& step = table.steps[leadingNext][weak][lower[i + 1] - lower[i] + MAX_MOTION];
+			int pairs[OFFSET_COUNT * OFFSET_COUNT];
+			int count = 0;
+			for (int candidate = 1; candidate < OFFSET_COUNT; candidate++) {
+				if (!(step.breakStrong & (1u << candidate))) continue;
+				uint16_t after = table.weakAfterStrong[leadingNext][candidate] & ~parallels(weak) & viable[i + 1];
+				for (int option = 1; option < OFFSET_COUNT; option++) {
+					if (after & (1u << option)) pairs[count++] = candidate * OFFSET_COUNT + option;
+				}
+			}
+			int holdable = 0;
+			for (int pair = 0; i + 3 < length && pair < count; pair++) {
+				if (tieOptions(i + 1, pairs[pair] % OFFSET_COUNT) != 0) pairs[holdable++] = pairs[pair];
+			}
+			if (holdable != 0) count = holdable;
+			int pair = pairs[rng.nextInt(count)];
+			strong = pair / OFFSET_COUNT;
+			next = pair % OFFSET_COUNT;
+			breaks++;
+		}
+		weak = next;
+		upperVoice.push_back(lower[i + 1] + strong);
+		upperVoice.push_back(lower[i + 1] + weak);
+		tied.push_back(0);
+		tied.push_back(0);
+	}
+
+	upperVoice.push_back(8);
+	tied.push_back(0);
+}
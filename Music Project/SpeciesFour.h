@@ -1,19 +1,51 @@
 #pragma once
-#include "Species.h"
-using namespace::std;
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+using namespace std;
 
-// TODO: Finish after SpeciesTwo -- Elliott
-class SpeciesFour :
-	public Species
-{
+/**
+ * @brief
+ * Fourth species: an upper voice of syncopations against a lower voice of half notes.
+ *
+ * Each lower note gets two upper quarter notes, the strong beat and the weak beat. A weak beat note is a consonance
+ * and is tied over into the next strong beat, where against the new lower note it is either still consonant, or a
+ * prepared dissonance (a 7th, 4th or 9th) that resolves down by step to a 6th, 3rd or octave on the weak beat. A 2-3
+ * suspension needs the lower voice suspended, and the lower voice here is fixed, so it doesn't occur. When no tie can
+ * go on (the held note would clash or can't resolve) the species is broken for one note: the strong beat is struck
+ * again as a new consonance. Weak beats that can't be held are only written when none that can would reach the
+ * cadence. Successive weak beats never make parallel fifths or octaves, and the voice ends with the leading tone on the
+ * last weak beat, then the octave.
+ *
+ * What a tie does depends only on the weak beat's interval above the lower note, how far the lower voice moves and
+ * whether the next lower note is a leading tone, so every case is worked out once, on first use, into a table. The
+ * constructor then marks, last note first, which weak beat intervals can still reach the cadence, and write() walks
+ * forward through them. It never dead-ends
+ */
+class SpeciesFour {
 public:
-	SpeciesFour();
-	~SpeciesFour();
-	/*Note chooseNextNote();
-	bool melodicRule4a();
-	bool melodicRule4b();
-	bool harmonicRule4a();
-	bool harmonicRule4b();
-	*/
-};
+	// Throws runtime_error if no upper voice fits the lower voice
+	SpeciesFour(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch = pmr::get_default_resource());
+
+	// Appends the strong and weak beat of every lower note but the last, then the final note. tied gets a flag for every
+	// note appended, set when the note is held into the next one. One or two draws per lower note, at its position
+	void write(Xorshift32& rng, pmr::vector<int>& upperVoice, pmr::vector<uint8_t>& tied);
+
+	// Of the last write()
+	int getSuspensions() const { return suspensions; }
+	int getBreaks() const { return breaks; }
 
+	static const int OFFSET_COUNT = 10;		// Scale steps above the lower note, unison to a tenth
+	static const int MAX_MOTION = 12;		// Furthest the lower voice may move between notes, in scale steps
+
+private:
+	const pmr::vector<int>& lower;
+	// viable[i] = weak beat offsets above lower[i] that can still reach the cadence, one bit per offset
+	pmr::vector<uint16_t> viable;
+	int suspensions = 0;
+	int breaks = 0;
+
+	uint16_t tieOptions(int position, int weak) const;
+	int pickWeak(int position, uint16_t options, Xorshift32& rng) const;
+};
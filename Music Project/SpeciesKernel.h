@@ -0,0 +1,27 @@
+#pragma once
+#include "Species.h"
+#include "SpeciesRules.h"
+#include <stdexcept>
+#include <string>
+using namespace std;
+
+/**
+ * @brief
+ * A first species style engine for one RuleSet (see SpeciesRules.h), with the rules fused into chooseNextNote at
+ * compile time. final, so calls through a SpeciesKernel aren't virtual either
+ *
+ * SpeciesKernel<FirstSpeciesRules> chooses the same note as SpeciesOne for the same draw
+ */
+template <class Rules>
+class SpeciesKernel final : public Species {
+public:
+	explicit SpeciesKernel(Xorshift32& rng) { setRng(rng); }
+
+	uint32_t allowedOptions() const { return Rules::allowed({ noteBelow, noteBefore, noteBeforeAndBelow, noteTwoBefore, position }); }
+
+	int chooseNextNote() {
+		uint32_t options = allowedOptions();
+		if (options == 0) throw runtime_error("No note above " + to_string(noteBelow) + " satisfies every rule");
+		return noteBelow + nthOption(options, rng->nextInt(countOptions(options)));
+	}
+};
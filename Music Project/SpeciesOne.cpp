@@ -1,11 +1,13 @@
 #include "SpeciesOne.h"
-#include "xorshift32.h"
 #include <iostream>
 #include <algorithm>
+#include <stdexcept>
+#include <string>
 
 
-SpeciesOne::SpeciesOne()
+SpeciesOne::SpeciesOne(Xorshift32& rng, pmr::memory_resource* scratch) : previousIntervals(scratch), lower(scratch), upper(scratch)
 {
+	setRng(rng);
 }
 
 
@@ -13,16 +15,11 @@ SpeciesOne::~SpeciesOne()
 {
 }
 
-int SpeciesOne::chooseNextNote() {
-	noteOptions.clear();
+void SpeciesOne::applyRules() {
 	h_cannotCrossMelody(); // fills in a range above and equal to note below
 	
 	//For debugging
-	//cout << "NoteOptions initialized:";
-	//for (auto o : noteOptions) {
-	//	cout << o << " ";
-	//}
-	//cout << endl;
+	//cout << "NoteOptions initialized: " << bitset<OPTION_COUNT>(noteOptions) << endl;
 	
 	// Removes bad notes
 	h_avoidDimFifth();
@@ -38,21 +35,23 @@ int SpeciesOne::chooseNextNote() {
 	if (!(count % 4 == 0)) {
 		h_removeEighth();
 	}
+}
+
+int SpeciesOne::chooseNextNote() {
+	applyRules();
 
 	// For debugging
-	//cout << "NoteOptions emptied:    ";
-	//for (auto o : noteOptions) {
-	//	cout << o << " ";
-	//}
-	//cout << endl;
+	//cout << "NoteOptions emptied:     " << bitset<OPTION_COUNT>(noteOptions) << endl;
 	if (previousIntervals.size() != 0) {
 		cout << "PreviousInterval: " << previousIntervals.at(previousIntervals.size() - 1) << endl;
 	}
 
-	int toChoose = Xorshift32::nextInt(noteOptions.size());
-	int chosen = noteOptions.at(toChoose);
+	// A third above is never removed by these rules, but a dead end must not reach nthOption
+	if (noteOptions == 0) throw runtime_error("No note above " + to_string(noteBelow) + " satisfies every rule");
+	int toChoose = rng->nextInt(countOptions(noteOptions));
+	int chosen = noteBelow + nthOption(noteOptions, toChoose);
 	
-	//cout << "toChoose: " << toChoose << " NoteBelow: " << noteBelow << " nextNote: " << noteOptions.at(toChoose);
+	//cout << "toChoose: " << toChoose << " NoteBelow: " << noteBelow << " nextNote: " << chosen;
 	return chosen;
 }
 
@@ -61,8 +60,13 @@ int SpeciesOne::chooseNextNote() {
 
 void SpeciesOne::writeImitativeTwoVoices(int length) {
 	
-	lower = writeImitativeLowerVoice(length);
-	for (int i = 0; i < length - 3; i++) {
+	writeImitativeTwoVoices(writeImitativeLowerVoice(length));
+}
+
+void SpeciesOne::writeImitativeTwoVoices(const pmr::vector<int>& lowerVoice) {
+	lower = lowerVoice;
+	upper.reserve(lower.size());
+	for (int i = 0; i < static_cast<int>(lower.size()) - 3; i++) {
 		int temp = lower.at(i);
 		upper.push_back(temp + 4); // Imitative counter point a fifth above
 	}
@@ -70,11 +74,13 @@ void SpeciesOne::writeImitativeTwoVoices(int length) {
 	upper.push_back(8);
 }
 
-vector<int> SpeciesOne::writeImitativeLowerVoice(int length) {
-	vector<int> ImitativeLowerVoice;
+pmr::vector<int> SpeciesOne::writeImitativeLowerVoice(int length) {
+	pmr::vector<int> ImitativeLowerVoice(lower.get_allocator());
+	ImitativeLowerVoice.reserve(length > 0 ? length : 0);
 	ImitativeLowerVoice.push_back(1);
 
 	for (int i = 0; i < length - 3; i++) {
+		rng->setPosition(i + 1);
 		int nextNote;
 		if (ImitativeLowerVoice.back() < -4) { // Sets bar for how low it will go
 			nextNote = ImitativeLowerVoice.back() + pickImitativeUp() - 1;
@@ -82,7 +88,7 @@ vector<int> SpeciesOne::writeImitativeLowerVoice(int length) {
 		else if (ImitativeLowerVoice.back() > 5) { // Sets bar for how high it will go
 			nextNote = ImitativeLowerVoice.back() - pickImitativeDown() - 1;
 		}
-		else if (Xorshift32::nextFloat() < 0.5) {
+		else if (rng->nextFloat() < 0.5) {
 			nextNote = ImitativeLowerVoice.back() - pickImitativeDown() - 1;
 		}
 		else {
@@ -96,7 +102,7 @@ vector<int> SpeciesOne::writeImitativeLowerVoice(int length) {
 }
 
 int SpeciesOne::pickImitativeUp() { // Returns the same note, a third, or a fifth above
-	switch (Xorshift32::nextInt(9)) {
+	switch (rng->nextInt(9)) {
 	case 0:
 		return 1;
 	case 1:
@@ -113,7 +119,7 @@ int SpeciesOne::pickImitativeUp() { // Returns the same note, a third, or a fift
 }
 
 int SpeciesOne::pickImitativeDown() { // Returns the same note, a second, or a fourth below
-	switch (Xorshift32::nextInt(7)) {
+	switch (rng->nextInt(7)) {
 	case 0:
 		return 1;
 	case 1:
@@ -142,121 +148,60 @@ void SpeciesOne::printImitativeCounterpoint() {
 }
 
 void SpeciesOne::h_cannotCrossMelody() {
-	for (int i = noteBelow+1; i < noteBelow+9; i++) {
-		noteOptions.push_back(i);
-	}
+	// Every note from a second to a ninth above the note below
+	noteOptions = ALL_OPTIONS;
 }
 
 void SpeciesOne::h_avoidDimFifth() {
-	if ((noteBelow == 0) || (noteBelow == 7)) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 4);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
+	// 5ths not allowed in this case
+	removeOptionIf(5, (noteBelow == 0) || (noteBelow == 7));
 }
 
 void SpeciesOne::h_noFourthOrSeventh() {
-	// Find any perfect fourths
-	vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 3);
-	if (itr != noteOptions.end()) {
-		noteOptions.erase(itr);	// Remove them
-	}
-	// Find any 7ths
-	vector<int>::iterator itrr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 6);
-	if (itrr != noteOptions.end()) {
-		noteOptions.erase(itrr);	// Remove them
-	}
+	removeOption(4);	// Perfect fourths
+	removeOption(7);	// 7ths
 }
 
 void SpeciesOne::h_noSecondOrNinth() {
-	// Find any 2nds
-	vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 1);
-	if (itr != noteOptions.end()) {
-		noteOptions.erase(itr);	// Remove them
-	}
-	// Find any 9ths
-	vector<int>::iterator itrr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 8);
-	if (itrr != noteOptions.end()) {
-		noteOptions.erase(itrr);	// Remove them
-	}
+	removeOption(2);	// 2nds
+	removeOption(9);	// 9ths
 }
 
 void SpeciesOne::h_removeEighth() {
-	vector<int>::iterator itrr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 7);
-	if (itrr != noteOptions.end()) {
-		noteOptions.erase(itrr);	// Remove them
-	}
+	removeOption(8);
 }
 
 void SpeciesOne::m_noParallelFifths() {
-	if ((noteBefore - 4) == noteBeforeAndBelow) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 4);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
+	removeOptionIf(5, (noteBefore - 4) == noteBeforeAndBelow);
 }
 
 void SpeciesOne::m_noSimilarFifths() {
-	if ((noteBeforeAndBelow > noteBelow) && ((noteBefore - 4) >= noteBeforeAndBelow)) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 4);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
-	if ((noteBeforeAndBelow < noteBelow) && ((noteBefore - 4) <= noteBeforeAndBelow)) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 4);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
+	// Reaching a 5th by similar motion from either direction
+	removeOptionIf(5, ((noteBeforeAndBelow > noteBelow) && ((noteBefore - 4) >= noteBeforeAndBelow))
+		| ((noteBeforeAndBelow < noteBelow) && ((noteBefore - 4) <= noteBeforeAndBelow)));
 }
 
 void SpeciesOne::m_noParallelOctaves() {
-	if ((noteBefore - 7) == noteBeforeAndBelow) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 7);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
+	removeOptionIf(8, (noteBefore - 7) == noteBeforeAndBelow);
 }
 
 void SpeciesOne::m_noSimilarOctaves() {
-	if ((noteBeforeAndBelow > noteBelow) && ((noteBefore - 7) >= noteBeforeAndBelow)) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 7);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
-	if ((noteBeforeAndBelow < noteBelow) && ((noteBefore - 7) <= noteBeforeAndBelow)) {
-		// 5ths not allowed in this case
-		vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBelow + 7);
-		if (itr != noteOptions.end()) {
-			noteOptions.erase(itr);
-		}
-	}
+	removeOptionIf(8, ((noteBeforeAndBelow > noteBelow) && ((noteBefore - 7) >= noteBeforeAndBelow))
+		| ((noteBeforeAndBelow < noteBelow) && ((noteBefore - 7) <= noteBeforeAndBelow)));
 }
 
 void SpeciesOne::m_noSameNote() {
-	vector<int>::iterator itr = find(noteOptions.begin(), noteOptions.end(), noteBefore);
-	if (itr != noteOptions.end()) {
-		noteOptions.erase(itr);
+	int interval = noteBefore - noteBelow + 1;
+	if (interval >= 2 && interval < OPTION_COUNT + 2) {	// Otherwise it was never an option
+		removeOption(interval);
 	}
 }
 
 void SpeciesOne::m_onlyUse1Once() {
 	previousIntervals.push_back(noteBefore - noteBeforeAndBelow + 1 );
 
-	vector<int>::iterator itr = find(previousIntervals.begin(), previousIntervals.end(), 1);
+	auto itr = find(previousIntervals.begin(), previousIntervals.end(), 1);
 	if (itr != previousIntervals.end()) {
-		noteOptions.erase(noteOptions.begin());
+		noteOptions &= noteOptions - 1;	// Removes the lowest option
 	}
 }
-
@@ -1,6 +1,9 @@
 #pragma once
 #include "Note.h"
 #include "Species.h"
+#include "SpeciesRules.h"
+#include <cstdint>
+#include <memory_resource>
 #include <vector>
 using namespace std;
 
@@ -8,22 +11,33 @@ using namespace std;
 
 class SpeciesOne : public Species {
 public:
-	SpeciesOne();
+	// Scratch vectors come from scratch, e.g. the Arena of the phrase being written
+	SpeciesOne(Xorshift32& rng, pmr::memory_resource* scratch = pmr::get_default_resource());
 	~SpeciesOne();
 	int chooseNextNote();
+	// Notes the rules allow above the note below, as a SpeciesRules.h bitmask
+	uint32_t allowedOptions() { applyRules(); return noteOptions; }
 
 	// These four functions go together. 
 	void writeImitativeTwoVoices(int length = 8);	// Uses writeLower
-	vector<int> writeImitativeLowerVoice(int length); // Uses Up and Down
+	void writeImitativeTwoVoices(const pmr::vector<int>& lowerVoice);	// Around a lower voice written elsewhere, e.g. by BeamSearch
+	pmr::vector<int> writeImitativeLowerVoice(int length); // Uses Up and Down
 	int pickImitativeUp();
 	int pickImitativeDown();
 	void printImitativeCounterpoint();
-	vector<int> getImitativeUpper() { return upper; }
-	vector<int> getImitativeLower() { return lower; }
+	const pmr::vector<int>& getImitativeUpper() const { return upper; }
+	const pmr::vector<int>& getImitativeLower() const { return lower; }
 		
 protected:
-	vector<int> noteOptions;
-	vector<int> previousIntervals;
+	// Candidates above noteBelow as a bitmask, laid out as in SpeciesRules.h. Each rule clears bits, so choosing a
+	// note never allocates or searches
+	uint32_t noteOptions = 0;
+	void removeOption(int interval) { noteOptions &= ~optionBit(interval); }
+	// Branch free, the bit is cleared only when remove is true
+	void removeOptionIf(int interval, bool remove) { noteOptions &= ~optionBitIf(interval, remove); }
+	pmr::vector<int> previousIntervals;
+	// Leaves the notes every rule allows in noteOptions
+	void applyRules();
 	// Now for the species rules.....
 	// h = harmonic, m = melodic
 	void h_cannotCrossMelody();
@@ -40,8 +54,8 @@ protected:
 	void m_onlyUse1Once();
 
 	// For imitative counterpoint
-	vector<int> lower;
-	vector<int> upper;
+	pmr::vector<int> lower;
+	pmr::vector<int> upper;
 	int count = 0;
 };
 
@@ -0,0 +1,107 @@
+#include "SpeciesOneEnumerator.h"
+#include <stdexcept>
+
+const uint32_t LIMB_BASE = 1000000000;
+
+ExactCount::ExactCount(uint32_t value) {
+	while (value > 0) {
+		limbs.push_back(value % LIMB_BASE);
+		value /= LIMB_BASE;
+	}
+}
+
+void ExactCount::add(const ExactCount& other) {
+	if (limbs.size() < other.limbs.size()) limbs.resize(other.limbs.size(), 0);
+	uint32_t carry = 0;
+	for (size_t i = 0; i < limbs.size(); i++) {
+		uint32_t sum = limbs[i] + carry + (i < other.limbs.size() ? other.limbs[i] : 0);	// Below 2^32, each part is < 1e9
+		limbs[i] = sum % LIMB_BASE;
+		carry = sum / LIMB_BASE;
+	}
+	if (carry > 0) limbs.push_back(carry);
+}
+
+string ExactCount::toString() const {
+	if (limbs.empty()) return "0";
+	string text = to_string(limbs.back());
+	for (size_t i = limbs.size() - 1; i-- > 0;) {
+		string limb = to_string(limbs[i]);
+		text += string(9 - limb.size(), '0') + limb;
+	}
+	return text;
+}
+
+SpeciesOneEnumerator::SpeciesOneEnumerator(const vector<int>& lowerVoice) : lower(lowerVoice), completions(lowerVoice.size()) {
+	int length = static_cast<int>(lower.size());
+	if (length < 3) throw runtime_error("The lower voice is too short for a cadence");
+
+	for (int position = length - 1; position >= 0; position--) {
+		for (int offset = 1; offset <= OPTION_COUNT; offset++) {
+			int note = lower[position] + offset;
+			ExactCount& ways = completions[position][offset - 1];
+			if ((position == length - 2 && note != 7) || (position == length - 1 && note != 8)) {
+				continue;	// Not the cadence
+			}
+			if (position == length - 1) {
+				ways = ExactCount(1);
+				continue;
+			}
+			uint32_t allowed = allowedAfter(position + 1, note);
+			for (int next = 1; next <= OPTION_COUNT; next++) {
+				if (allowed & (1u << (next - 1))) ways.add(completions[position + 1][next - 1]);
+			}
+		}
+	}
+
+	for (int first : { 5, 8 }) {
+		int offset = first - lower[0];
+		if (offset >= 1 && offset <= OPTION_COUNT) total.add(completions[0][offset - 1]);
+	}
+}
+
+uint32_t SpeciesOneEnumerator::allowedAfter(int position, int noteBefore) const {
+	// Nothing in FirstSpeciesRules looks further back than the note before
+	return FirstSpeciesRules::allowed({ lower[position], noteBefore, lower[position - 1], 0, position });
+}
+
+uint32_t SpeciesOneEnumerator::viable(int position, uint32_t allowed) const {
+	uint32_t options = 0;
+	for (int offset = 1; offset <= OPTION_COUNT; offset++) {
+		if ((allowed & (1u << (offset - 1))) && !completions[position][offset - 1].isZero()) options |= 1u << (offset - 1);
+	}
+	return options;
+}
+
+uint64_t SpeciesOneEnumerator::enumerate(const function<bool(const vector<int>&)>& visit) const {
+	int length = static_cast<int>(lower.size());
+	uint32_t firstNotes = 0;
+	for (int first : { 5, 8 }) {
+		int offset = first - lower[0];
+		if (offset >= 1 && offset <= OPTION_COUNT) firstNotes |= 1u << (offset - 1);
+	}
+
+	// remaining[p] holds the options at p not visited yet, voice[p] the one being visited
+	vector<uint32_t> remaining(length, 0);
+	vector<int> voice(length, 0);
+	remaining[0] = viable(0, firstNotes);
+	uint64_t visited = 0;
+	int position = 0;
+	while (position >= 0) {
+		if (remaining[position] == 0) {
+			position--;
+			continue;
+		}
+		uint32_t lowest = remaining[position] & (0u - remaining[position]);
+		remaining[position] &= remaining[position] - 1;
+		voice[position] = lower[position] + nthOption(lowest, 0);
+
+		if (position == length - 1) {
+			visited++;
+			if (!visit(voice)) break;
+			continue;
+		}
+		position++;
+		remaining[position] = viable(position, allowedAfter(position, voice[position - 1]));
+	}
+	return visited;
+}
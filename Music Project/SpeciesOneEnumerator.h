@@ -0,0 +1,56 @@
+#pragma once
+#include "SpeciesRules.h"
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+using namespace std;
+
+// Unsigned integer of any size, only as much as counting paths needs
+class ExactCount {
+public:
+	explicit ExactCount(uint32_t value = 0);
+	void add(const ExactCount& other);
+	bool isZero() const { return limbs.empty(); }
+	string toString() const;
+
+private:
+	vector<uint32_t> limbs;		// Base 1e9, least significant first, no leading zeros
+};
+
+/**
+ * @brief
+ * Every first species upper voice allowed against a lower voice, counted exactly or listed one at a time.
+ *
+ * The voices are the ones SpeciesOneUniform samples from: starting on 5 or 8, ending 7, 8, every note a second to a
+ * ninth above the lower voice and allowed by FirstSpeciesRules. The constructor counts the completions from every
+ * (position, note) state, last note first, so counting takes time linear in the length. enumerate() only steps into
+ * states with completions, so it never backtracks and holds one voice at a time however many there are
+ */
+class SpeciesOneEnumerator {
+public:
+	explicit SpeciesOneEnumerator(const vector<int>& lowerVoice);
+
+	const ExactCount& count() const { return total; }
+
+	/**
+	 * @brief
+	 * Calls visit with each upper voice (scale degrees, one per lower voice note), lowest notes first.
+	 * Stops early if visit returns false
+	 *
+	 * @return
+	 * How many voices were visited
+	 */
+	uint64_t enumerate(const function<bool(const vector<int>&)>& visit) const;
+
+private:
+	vector<int> lower;
+	// completions[p][o - 1] = ways to finish the voice after the note lower[p] + o at position p
+	vector<array<ExactCount, OPTION_COUNT>> completions;
+	ExactCount total;
+
+	uint32_t allowedAfter(int position, int noteBefore) const;
+	// Options at a position that lead to at least one complete voice
+	uint32_t viable(int position, uint32_t allowed) const;
+};
@@ -0,0 +1,66 @@
+#include "SpeciesOneTable.h"
+#include "SpeciesOne.h"
+#include <algorithm>
+
+namespace {
+	// Runs SpeciesOne's rules for a made up state, so the table can't drift from them
+	class RuleProbe : public SpeciesOne {
+	public:
+		explicit RuleProbe(Xorshift32& rng) : SpeciesOne(rng) {}
+		uint32_t allowed(int below, int before, int beforeAndBelow) {
+			setNoteBelow(below);
+			setNoteBefore(before);
+			setNoteBeforeAndBelow(beforeAndBelow);
+			applyRules();
+			return noteOptions;
+		}
+	};
+}
+
+SpeciesOneTable::SpeciesOneTable(Xorshift32& rng) : table(getTable()) {
+	setRng(rng);
+}
+
+int SpeciesOneTable::stateIndex(bool leadingToneBelow, int lowerMotion, int previousInterval) {
+	previousInterval = min(max(previousInterval, MIN_INTERVAL), MAX_INTERVAL);
+	return ((leadingToneBelow ? 3 : 0) + lowerMotion + 1) * (MAX_INTERVAL - MIN_INTERVAL + 1) + previousInterval - MIN_INTERVAL;
+}
+
+const SpeciesOneTable::Successors* SpeciesOneTable::buildTable() {
+	static Successors table[STATE_COUNT];
+	Xorshift32 unused(1);
+	RuleProbe probe(unused);
+	for (int leadingToneBelow = 0; leadingToneBelow <= 1; leadingToneBelow++) {
+		for (int lowerMotion = -1; lowerMotion <= 1; lowerMotion++) {
+			for (int previousInterval = MIN_INTERVAL; previousInterval <= MAX_INTERVAL; previousInterval++) {
+				// Scale degree 7 is a leading tone and 1 isn't, the note before and below sets the motion
+				int below = leadingToneBelow ? 7 : 1;
+				int beforeAndBelow = below - lowerMotion;
+				uint32_t allowed = probe.allowed(below, beforeAndBelow + previousInterval, beforeAndBelow);
+
+				Successors& successors = table[stateIndex(leadingToneBelow, lowerMotion, previousInterval)];
+				successors.options = allowed;
+				successors.count = 0;
+				for (int offset = 1; offset <= 8; offset++) {
+					if (allowed & (1u << (offset - 1))) successors.offsets[successors.count++] = static_cast<int8_t>(offset);
+				}
+			}
+		}
+	}
+	return table;
+}
+
+const SpeciesOneTable::Successors* SpeciesOneTable::getTable() {
+	static const Successors* table = buildTable();
+	return table;
+}
+
+int SpeciesOneTable::currentState() const {
+	int lowerMotion = (noteBelow > noteBeforeAndBelow) - (noteBelow < noteBeforeAndBelow);
+	return stateIndex(noteBelow == 0 || noteBelow == 7, lowerMotion, noteBefore - noteBeforeAndBelow);
+}
+
+int SpeciesOneTable::chooseNextNote() {
+	const Successors& successors = table[currentState()];
+	return noteBelow + successors.offsets[rng->nextInt(successors.count)];
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "Species.h"
+#include <cstdint>
+using namespace std;
+
+// First species with every rule decision made up front. The notes SpeciesOne allows depend only on whether the note
+// below is a leading tone, which way the lower voice moved and the interval the voices were at before, so the allowed
+// notes for each of those states are worked out once (by running SpeciesOne's own rules) and choosing a note is one
+// table lookup and one draw. Chooses the same note as SpeciesOne for the same draw
+class SpeciesOneTable : public Species {
+public:
+	explicit SpeciesOneTable(Xorshift32& rng);
+	int chooseNextNote();
+	uint32_t allowedOptions() const { return table[currentState()].options; }
+
+	// Allowed notes for one state, as scale steps above the note below, lowest first
+	struct Successors {
+		uint32_t options;	// The same notes as a SpeciesRules.h bitmask
+		uint8_t count;
+		int8_t offsets[8];
+	};
+	// Previous intervals below a fourth or above an octave all behave the same, so they are clamped to this range
+	static const int MIN_INTERVAL = 3;
+	static const int MAX_INTERVAL = 8;
+	static const int STATE_COUNT = 2 * 3 * (MAX_INTERVAL - MIN_INTERVAL + 1);
+	// Built on first use, shared by every thread
+	static const Successors* getTable();
+
+private:
+	const Successors* table;
+	int currentState() const;
+	static int stateIndex(bool leadingToneBelow, int lowerMotion, int previousInterval);
+	static const Successors* buildTable();
+};
@@ -0,0 +1,79 @@
+#include "SpeciesOneUniform.h"
+#include <algorithm>
+#include <stdexcept>
+
+SpeciesOneUniform::SpeciesOneUniform(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch)
+	: lower(lowerVoice), completions(lowerVoice.size(), array<double, OPTION_COUNT>(), scratch) {
+	int length = static_cast<int>(lower.size());
+	if (length < 3) throw runtime_error("The lower voice is too short for a cadence");
+
+	for (int position = length - 1; position >= 0; position--) {
+		array<double, OPTION_COUNT>& ways = completions[position];
+		double largest = 0;
+		for (int offset = 1; offset <= OPTION_COUNT; offset++) {
+			int note = lower[position] + offset;
+			double count;
+			if ((position == length - 2 && note != 7) || (position == length - 1 && note != 8)) {
+				count = 0;	// Not the cadence
+			}
+			else if (position == length - 1) {
+				count = 1;
+			}
+			else {
+				count = 0;
+				uint32_t allowed = allowedAfter(position + 1, note);
+				for (int next = 1; next <= OPTION_COUNT; next++) {
+					if (allowed & (1u << (next - 1))) count += completions[position + 1][next - 1];
+				}
+			}
+			ways[offset - 1] = count;
+			largest = max(largest, count);
+		}
+		if (largest > 0) {
+			for (auto& count : ways) count /= largest;
+		}
+	}
+
+	if (weight(0, 5) == 0 && weight(0, 8) == 0) throw runtime_error("No first species upper voice fits this lower voice");
+}
+
+uint32_t SpeciesOneUniform::allowedAfter(int position, int noteBefore) const {
+	// Nothing in FirstSpeciesRules looks further back than the note before
+	return FirstSpeciesRules::allowed({ lower[position], noteBefore, lower[position - 1], 0, position });
+}
+
+double SpeciesOneUniform::weight(int position, int note) const {
+	int offset = note - lower[position];
+	return offset >= 1 && offset <= OPTION_COUNT ? completions[position][offset - 1] : 0;
+}
+
+void SpeciesOneUniform::sample(Xorshift32& rng, pmr::vector<int>& upperVoice) const {
+	int length = static_cast<int>(lower.size());
+	upperVoice.reserve(upperVoice.size() + length);
+
+	rng.setPosition(0);
+	double fifth = weight(0, 5);
+	upperVoice.push_back(rng.nextFloat() * (fifth + weight(0, 8)) < fifth ? 5 : 8);
+
+	for (int position = 1; position < length - 2; position++) {
+		uint32_t allowed = allowedAfter(position, upperVoice.back());
+		double total = 0;
+		for (int offset = 1; offset <= OPTION_COUNT; offset++) {
+			if (allowed & (1u << (offset - 1))) total += completions[position][offset - 1];
+		}
+
+		rng.setPosition(position);
+		double target = rng.nextFloat() * total;
+		int chosen = 0;
+		for (int offset = 1; offset <= OPTION_COUNT; offset++) {
+			double ways = allowed & (1u << (offset - 1)) ? completions[position][offset - 1] : 0;
+			if (ways == 0) continue;
+			chosen = offset;	// The last one with any completions catches rounding at the top end
+			if (target < ways) break;
+			target -= ways;
+		}
+		upperVoice.push_back(lower[position] + chosen);
+	}
+	upperVoice.push_back(7);
+	upperVoice.push_back(8);
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "SpeciesRules.h"
+#include "xorshift32.h"
+#include <array>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief
+ * First species upper voices drawn uniformly from every one the rules allow against a fixed lower voice.
+ *
+ * The upper voice starts on 5 or 8 and ends 7, 8 like writeUpperVoiceOne's, with every note in between (and the
+ * cadence) allowed by FirstSpeciesRules. Those rules only look at the note before, so the voices form paths through a
+ * graph with at most 8 states per note. The constructor counts the completions from every state, last note first,
+ * and sample() walks forward choosing each note in proportion to its completions. Linear in the phrase length, and
+ * it never dead-ends
+ */
+class SpeciesOneUniform {
+public:
+	// Throws runtime_error if no upper voice fits the lower voice
+	SpeciesOneUniform(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch = pmr::get_default_resource());
+
+	// Appends one upper voice, one draw per note (at its position, for counter mode)
+	void sample(Xorshift32& rng, pmr::vector<int>& upperVoice) const;
+
+private:
+	const pmr::vector<int>& lower;
+	// completions[p][o - 1] = valid ways to finish the voice after the note lower[p] + o at position p. Each position
+	// is scaled so its largest entry is 1, only the ratios within a position matter and the raw counts would overflow
+	pmr::vector<array<double, OPTION_COUNT>> completions;
+
+	uint32_t allowedAfter(int position, int noteBefore) const;
+	double weight(int position, int note) const;
+};
@@ -0,0 +1,202 @@
+#include "SpeciesOneVoices.h"
+#include "IntervalRules.h"
+#include <algorithm>
+#include <cstdlib>
+#include <stdexcept>
+#include <string>
+
+// 3rds, 5ths, 6ths and octaves at any distance, and 4ths between upper voices, but never a unison or a tritone
+static bool isConsonant(int low, int high, bool overBass) {
+	int interval = high - low;
+	if (interval <= 0) return false;
+	int step = interval % 7;
+	if (step == 1 || step == 6 || (step == 3 && overBass)) return false;
+	// F up to B, or B up to F
+	return !(step == 3 && degreeClass(low) == 3) && !(step == 4 && isLeadingTone(low));
+}
+
+// A 5th or octave at any distance, voices here can be further apart than a tenth
+static bool isPerfectAbove(int low, int high) {
+	return isPerfect(isLeadingTone(low), (high - low - 1) % 7 + 1);
+}
+
+// Inner voices may also hold a note
+static bool moveAllowed(int move, bool inner) {
+	return (inner && move == 0) || moveAllowed(move);
+}
+
+// How two voices move from one chord to the next. outer is set for the top voice and the bass, adjacent when no voice
+// lies between them
+static bool motionAllowed(int lowBefore, int low, int highBefore, int high, bool outer, bool adjacent) {
+	// Fifths and octaves in parallel or contrary motion, the same kind twice with both voices moving
+	bool bothMove = low != lowBefore && high != highBefore;
+	if (bothMove && isPerfectAbove(low, high) && isPerfectAbove(lowBefore, highBefore) && (high - low) % 7 == (highBefore - lowBefore) % 7) return false;
+	// Hidden fifths and octaves, reached in similar motion with a leap above
+	if (outer && isPerfectAbove(low, high) && (low - lowBefore) * (high - highBefore) > 0 && abs(high - highBefore) > 1) return false;
+	return !(adjacent && (low >= highBefore || high <= lowBefore));
+}
+
+SpeciesOneVoices::SpeciesOneVoices(const pmr::vector<int>& bass, int voiceCount, pmr::memory_resource* scratch)
+	: bass(bass), voiceCount(voiceCount), chordNotes(scratch), chordStart(scratch), moveStart(scratch), moveTarget(scratch), moveBreaks(scratch), notes(scratch) {
+	if (voiceCount < 3 || voiceCount > MAX_VOICES) {
+		throw runtime_error("First species for several voices takes 3 to " + to_string(MAX_VOICES) + " voices, not " + to_string(voiceCount));
+	}
+	int length = static_cast<int>(bass.size());
+	if (length < 3 || degreeClass(bass[length - 1]) != 0 || !isConsonant(bass[length - 2], 7, true)) {
+		throw runtime_error("No cadence for several voices fits this bass");
+	}
+
+	int chord[MAX_VOICES];
+	chordStart.push_back(0);
+	for (int column = 0; column < length; column++) {
+		addChords(column, 0, chord);
+		chordStart.push_back(static_cast<int>(chordNotes.size()) / (voiceCount - 1));
+	}
+
+	// Every chord that can follow each chord
+	moveStart.push_back(0);
+	for (int column = 0; column < length; column++) {
+		for (int index = 0; index < chordCount(column); index++) {
+			for (int next = 0; column + 1 < length && next < chordCount(column + 1); next++) {
+				if (follows(column, chordAt(column, index), chordAt(column + 1, next))) moveTarget.push_back(static_cast<int16_t>(next));
+			}
+			moveStart.push_back(static_cast<int>(moveTarget.size()));
+		}
+	}
+
+	// Last column first, the fewest leap breaks after each move. A move into the cadence has none left
+	moveBreaks.assign(moveTarget.size(), UNREACHABLE);
+	for (int move = moveStart[chordStart[length - 2]]; move < moveStart[chordStart[length - 1]]; move++) moveBreaks[move] = 0;
+	for (int column = length - 3; column >= 0; column--) {
+		for (int index = 0; index < chordCount(column); index++) {
+			const int8_t* chord = chordAt(column, index);
+			int from = chordStart[column] + index;
+			for (int move = moveStart[from]; move < moveStart[from + 1]; move++) {
+				int next = chordStart[column + 1] + moveTarget[move];
+				for (int after = moveStart[next]; after < moveStart[next + 1]; after++) {
+					moveBreaks[move] = min(moveBreaks[move], breaksAfter(column + 1, chord, chordAt(column + 1, moveTarget[move]), after));
+				}
+			}
+		}
+	}
+
+	leapBreaks = UNREACHABLE;
+	for (int move = 0; move < moveStart[chordStart[1]]; move++) leapBreaks = min(leapBreaks, static_cast<int>(moveBreaks[move]));
+	if (leapBreaks == UNREACHABLE) throw runtime_error("No " + to_string(voiceCount) + " voice first species fits this bass");
+}
+
+void SpeciesOneVoices::addChords(int column, int voice, int* chord) {
+	int length = static_cast<int>(bass.size());
+	int upper = voiceCount - 1;
+	if (voice == upper) {
+		if (static_cast<int>(chordNotes.size()) / upper - chordStart[column] >= MAX_CHORDS) {
+			throw runtime_error("Too many chords over bass note " + to_string(column));
+		}
+		for (int above = 0; above < upper; above++) chordNotes.push_back(static_cast<int8_t>(chord[above]));
+		return;
+	}
+
+	// The top voice keeps to its range and ends with the leading tone into the octave. Every other voice stays below
+	// the one above and within an octave of it, and the lowest within MAX_SPACING of the bass
+	int below = bass[column];
+	int lowest = below + 1;
+	int highest = TOP_HIGHEST;
+	if (voice == 0) {
+		lowest = max(lowest, TOP_LOWEST);
+		if (column >= length - 2) lowest = highest = column == length - 1 ? 8 : 7;
+	}
+	else {
+		lowest = max(lowest, chord[voice - 1] - 7);
+		highest = chord[voice - 1] - 1;
+	}
+	if (voice == upper - 1) highest = min(highest, below + MAX_SPACING);
+
+	for (int note = lowest; note <= highest; note++) {
+		// The tonic chord (degrees 1, 3 and 5) at either end, the top voice opening on a fifth or octave
+		if ((column == 0 || column == length - 1) && !(0x15 >> degreeClass(note) & 1)) continue;
+		if (column == 0 && voice == 0 && !isPerfectAbove(below, note)) continue;
+		// Only the pairs this note makes: the bass, then every voice above it
+		bool allowed = isConsonant(below, note, true);
+		for (int above = 0; allowed && above < voice; above++) allowed = isConsonant(note, chord[above], false);
+		if (!allowed) continue;
+		chord[voice] = note;
+		addChords(column, voice + 1, chord);
+	}
+}
+
+bool SpeciesOneVoices::follows(int column, const int8_t* chord, const int8_t* next) const {
+	int upper = voiceCount - 1;
+	for (int voice = 0; voice < upper; voice++) {
+		if (!moveAllowed(next[voice] - chord[voice], voice > 0)) return false;
+	}
+	for (int voice = 0; voice < upper; voice++) {
+		if (!motionAllowed(bass[column], bass[column + 1], chord[voice], next[voice], voice == 0, voice == upper - 1)) return false;
+		for (int above = 0; above < voice; above++) {
+			if (!motionAllowed(chord[voice], next[voice], chord[above], next[above], false, above == voice - 1)) return false;
+		}
+	}
+	return true;
+}
+
+uint16_t SpeciesOneVoices::breaksAfter(int column, const int8_t* before, const int8_t* chord, int move) const {
+	if (moveBreaks[move] == UNREACHABLE) return UNREACHABLE;
+	const int8_t* next = chordAt(column + 1, moveTarget[move]);
+	for (int voice = 0; voice < voiceCount - 1; voice++) {
+		if (leapProblem(chord[voice] - before[voice], next[voice] - chord[voice])) return moveBreaks[move] + 1;
+	}
+	return moveBreaks[move];
+}
+
+void SpeciesOneVoices::write(Xorshift32& rng) {
+	int length = static_cast<int>(bass.size());
+	int upper = voiceCount - 1;
+	notes.assign(upper * length, 0);
+
+	// The opening chord, then one move per column that still reaches the cadence within the breaks left
+	int budget = leapBreaks;
+	int from = 0;
+	const int8_t* before = nullptr;
+	for (int column = 0; column < length; column++) {
+		rng.setPosition(column);
+		int first = column == 0 ? 0 : moveStart[from];
+		int count = column == 0 ? chordCount(0) : moveStart[from + 1] - first;
+		const int8_t* chord = column == 0 ? nullptr : chordAt(column - 1, from - chordStart[column - 1]);
+
+		// Steps and held notes are favoured over leaps
+		double weights[MAX_CHORDS] = {};
+		uint16_t breaks[MAX_CHORDS] = {};
+		double total = 0;
+		for (int option = 0; option < count; option++) {
+			int target = column == 0 ? option : moveTarget[first + option];
+			if (column == 0) {
+				breaks[option] = UNREACHABLE;
+				for (int move = moveStart[option]; move < moveStart[option + 1]; move++) breaks[option] = min(breaks[option], moveBreaks[move]);
+			}
+			else breaks[option] = before != nullptr ? breaksAfter(column - 1, before, chord, first + option) : moveBreaks[first + option];
+			if (breaks[option] > budget) continue;
+			const int8_t* next = chordAt(column, target);
+			int smooth = 0;
+			for (int voice = 0; chord != nullptr && voice < upper; voice++) {
+				if (abs(next[voice] - chord[voice]) <= 1) smooth++;
+			}
+			weights[option] = 1 << smooth;
+			total += weights[option];
+		}
+		double target = rng.nextFloat() * total;
+		int chosen = 0;
+		for (int option = 0; option < count; option++) {
+			if (weights[option] == 0) continue;
+			chosen = option;		// The last option catches rounding at the top end
+			if (target < weights[option]) break;
+			target -= weights[option];
+		}
+
+		// A break here is one fewer left for the rest of the phrase
+		if (column > 0) budget -= breaks[chosen] - moveBreaks[first + chosen];
+		int index = column == 0 ? chosen : moveTarget[first + chosen];
+		before = chord;
+		from = chordStart[column] + index;
+		const int8_t* next = chordAt(column, index);
+		for (int voice = 0; voice < upper; voice++) notes[voice * length + column] = next[voice];
+	}
+}
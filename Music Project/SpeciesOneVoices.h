@@ -0,0 +1,70 @@
+#pragma once
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief
+ * First species for three or four voices (SATB style): every upper voice moves note against note over a fixed bass.
+ *
+ * Every upper voice is consonant with the bass, and the upper voices with each other, where a fourth counts too but a
+ * tritone never does. No two voices move in fifths or octaves, the outer voices don't reach one in similar motion with
+ * a leap in the top voice, voices never cross, overlap or meet in a unison, and neighbouring upper voices stay within
+ * an octave. Each voice moves as a first species voice does, though inner voices may repeat a note. The phrase opens
+ * and closes on the tonic chord, with the top voice a fifth or octave above the bass at first and ending with the
+ * leading tone into the octave.
+ *
+ * The constructor lists the chords each bass note allows, adding a voice at a time and checking each new note only
+ * against the bass and the notes already in its chord. Whether one chord can follow another is then a check of each
+ * voice's move and each pair's motion, so no candidate ever rescans the phrase. The leap rules look two chords back,
+ * so last column first it works out, for every chord that can follow another, the fewest columns after it where they
+ * have to be broken to reach the cadence. write() walks forward through them, one draw per column, and never
+ * dead-ends. Most basses need no breaks, and the rest get as few as they allow
+ */
+class SpeciesOneVoices {
+public:
+	// voiceCount counts the bass. Throws runtime_error unless it is 3 to MAX_VOICES and an upper voice fits the bass
+	SpeciesOneVoices(const pmr::vector<int>& bass, int voiceCount, pmr::memory_resource* scratch = pmr::get_default_resource());
+
+	// Writes every upper voice, one draw per column at its position
+	void write(Xorshift32& rng);
+
+	// Scale degree of the upper voice's note at column, voice 0 being the top one
+	int noteAt(int voice, int column) const { return notes[voice * bass.size() + column]; }
+	int getVoiceCount() const { return voiceCount; }
+	// Columns where every upper voice has to break the leap rules in some voice, 0 unless the bass leaves no other way.
+	// Every write() breaks them this many times
+	int getLeapBreaks() const { return leapBreaks; }
+
+	static const int MAX_VOICES = 4;
+	static const int MAX_CHORDS = 256;		// Chords a bass note allows, the most is well under half of this
+	static const int TOP_LOWEST = 1;		// Scale degrees the top voice keeps to, middle C to the A above the octave
+	static const int TOP_HIGHEST = 13;
+	static const int MAX_SPACING = 14;		// Furthest the lowest upper voice may be above the bass, two octaves
+
+private:
+	const pmr::vector<int>& bass;
+	int voiceCount;
+	// Upper voice notes of every chord, top first, column by column. chordStart[column] is the first chord's index
+	pmr::vector<int8_t> chordNotes;
+	pmr::vector<int> chordStart;
+	// The chords that can follow each chord, as indices in the next column, starting at moveStart[chord's index in
+	// chordStart order]. moveBreaks holds the fewest leap breaks after each move, UNREACHABLE if it can't reach the cadence
+	pmr::vector<int> moveStart;
+	pmr::vector<int16_t> moveTarget;
+	pmr::vector<uint16_t> moveBreaks;
+	// One row of bass.size() notes per upper voice, the top one first
+	pmr::vector<int> notes;
+	int leapBreaks = 0;
+
+	void addChords(int column, int voice, int* chord);
+	const int8_t* chordAt(int column, int index) const { return &chordNotes[(chordStart[column] + index) * (voiceCount - 1)]; }
+	int chordCount(int column) const { return chordStart[column + 1] - chordStart[column]; }
+	// Whether chord next over the bass at column + 1 can follow chord at column
+	bool follows(int column, const int8_t* chord, const int8_t* next) const;
+	// Leap breaks after the move from chord at column, reached from before, UNREACHABLE if it can't reach the cadence
+	uint16_t breaksAfter(int column, const int8_t* before, const int8_t* chord, int move) const;
+	static constexpr uint16_t UNREACHABLE = 0xffff;
+};
@@ -0,0 +1,115 @@
+#pragma once
+#include <bitset>
+#include <cstdint>
+#if defined(__BMI2__)
+#include <immintrin.h>
+#endif
+using namespace std;
+
+// Rules for choosing a note above the lower voice, as types that can be put together at compile time.
+//
+// Candidates are a bitmask over the notes from a second to a ninth above the note below: bit i set means
+// noteBelow + 1 + i (an interval of i + 2) is still allowed. A rule is a struct with a static remove() returning the
+// bits it rules out, and RuleSet<Rules...> ORs them all together. Everything is inline, so each RuleSet compiles to one
+// branch free function with no virtual calls. A variant is just another RuleSet, e.g.
+//
+//   using StrictFirstSpecies = RuleSet<FirstSpeciesRules, NoSameNote>;
+//
+// then SpeciesKernel<StrictFirstSpecies> (SpeciesKernel.h) writes notes with it
+
+const int OPTION_COUNT = 8;
+const uint32_t ALL_OPTIONS = (1u << OPTION_COUNT) - 1;
+
+inline uint32_t optionBit(int interval) { return 1u << (interval - 2); }
+// Branch free, optionBit(interval) when rule is true and nothing otherwise
+inline uint32_t optionBitIf(int interval, bool rule) { return optionBit(interval) & (0u - rule); }
+
+inline int countOptions(uint32_t options) {
+#if defined(__GNUC__)
+	return __builtin_popcount(options);
+#else
+	return static_cast<int>(bitset<32>(options).count());
+#endif
+}
+
+// Scale steps above the note below of the n-th remaining option, counting from 0 and lowest first
+inline int nthOption(uint32_t options, int n) {
+#if defined(__BMI2__)
+	// Deposits a single bit into the n-th set position
+	options = _pdep_u32(1u << n, options);
+#else
+	for (; n > 0; n--) options &= options - 1;	// Clear the lowest set bit
+#endif
+#if defined(__GNUC__)
+	return __builtin_ctz(options) + 1;
+#else
+	int steps = 1;
+	while (!(options & 1u)) {
+		options >>= 1;
+		steps++;
+	}
+	return steps;
+#endif
+}
+
+// What a rule may look at, in scale degrees as in Species
+struct RuleContext {
+	int noteBelow;
+	int noteBefore;
+	int noteBeforeAndBelow;
+	int noteTwoBefore;
+	int position;			// Index of the note in the voice
+};
+
+// Every rule's bits, nothing of the rest of the RuleSet. A RuleSet is itself a rule, so sets can be nested
+template <class... Rules>
+struct RuleSet {
+	static uint32_t remove(const RuleContext& note) { return (0u | ... | Rules::remove(note)); }
+	static uint32_t allowed(const RuleContext& note) { return ALL_OPTIONS & ~remove(note); }
+};
+
+// The same rules SpeciesOne applies (h = harmonic, m = melodic in its names)
+
+struct AvoidDimFifth {
+	// A fifth above a leading tone is diminished
+	static uint32_t remove(const RuleContext& note) { return optionBitIf(5, note.noteBelow == 0 || note.noteBelow == 7); }
+};
+
+struct NoFourthOrSeventh {
+	static uint32_t remove(const RuleContext&) { return optionBit(4) | optionBit(7); }
+};
+
+struct NoSecondOrNinth {
+	static uint32_t remove(const RuleContext&) { return optionBit(2) | optionBit(9); }
+};
+
+// No perfect interval reached in parallel or similar motion
+template <int Interval>
+struct NoParallelOrSimilar {
+	static uint32_t remove(const RuleContext& note) {
+		int fromBefore = note.noteBefore - (Interval - 1);
+		bool parallel = fromBefore == note.noteBeforeAndBelow;
+		bool similar = (note.noteBeforeAndBelow > note.noteBelow && fromBefore >= note.noteBeforeAndBelow)
+			|| (note.noteBeforeAndBelow < note.noteBelow && fromBefore <= note.noteBeforeAndBelow);
+		return optionBitIf(Interval, parallel | similar);
+	}
+};
+using NoParallelFifths = NoParallelOrSimilar<5>;
+using NoParallelOctaves = NoParallelOrSimilar<8>;
+
+using FirstSpeciesRules = RuleSet<AvoidDimFifth, NoFourthOrSeventh, NoSecondOrNinth, NoParallelFifths, NoParallelOctaves>;
+
+// Variant rules, not in FirstSpeciesRules
+
+struct NoSameNote {
+	// Don't repeat the note before
+	static uint32_t remove(const RuleContext& note) {
+		int interval = note.noteBefore - note.noteBelow + 1;
+		return interval >= 2 && interval < OPTION_COUNT + 2 ? optionBit(interval) : 0;
+	}
+};
+
+struct NoOctaveOffDownbeat {
+	// Octaves only on the first beat of a 4/4 measure, what SpeciesOne's h_removeEighth was meant for
+	static uint32_t remove(const RuleContext& note) { return optionBitIf(8, note.position % 4 != 0); }
+};
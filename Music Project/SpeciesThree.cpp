@@ -0,0 +1,216 @@
+#include "SpeciesThree.h"
+#include "IntervalRules.h"
+#include <cstdlib>
+#include <stdexcept>
+
+const int OFFSETS = SpeciesThree::OFFSET_COUNT;
+const int MOTIONS = 2 * SpeciesThree::MAX_MOTION + 1;
+const int MAX_FIGURES = (OFFSETS - 1) * (OFFSETS - 1) * (OFFSETS - 1) * (OFFSETS - 1);
+
+// One measure of the upper voice, in scale steps above its lower note
+struct Figure {
+	uint8_t notes[4];
+	uint8_t weight;			// Steps are favoured over leaps
+	uint8_t dissonances;
+	uint8_t cambiata;
+};
+
+// A set of bar line crossings, one bit per (downbeat, second quarter) of the next figure
+struct Openings {
+	uint64_t bits[2] = {};
+
+	bool has(int opening) const { return bits[opening / 64] >> (opening % 64) & 1; }
+	void set(int opening) { bits[opening / 64] |= uint64_t(1) << (opening % 64); }
+	void clear(int opening) { bits[opening / 64] &= ~(uint64_t(1) << (opening % 64)); }
+	bool meets(const Openings& other) const { return (bits[0] & other.bits[0]) || (bits[1] & other.bits[1]); }
+};
+
+static int opening(const Figure& figure) {
+	return figure.notes[0] * OFFSETS + figure.notes[1];
+}
+
+static int ending(const Figure& figure) {
+	return (figure.notes[0] * OFFSETS + figure.notes[2]) * OFFSETS + figure.notes[3];
+}
+
+struct FigureTable {
+	// [leading tone below] every figure that keeps the rules inside its measure
+	Figure figures[2][MAX_FIGURES];
+	int counts[2] = {};
+	// [leading tone below][third quarter][fourth quarter][lower motion + MAX_MOTION] openings of the next figure
+	// that can follow, before the downbeats are checked for parallels
+	Openings crossings[2][OFFSETS][OFFSETS][MOTIONS];
+
+	FigureTable() {
+		for (int leading = 0; leading < 2; leading++) {
+			for (int figure = 0; figure < MAX_FIGURES; figure++) {
+				int notes[4];
+				for (int beat = 3, rest = figure; beat >= 0; beat--, rest /= OFFSETS - 1) notes[beat] = 1 + rest % (OFFSETS - 1);
+				add(leading, notes);
+			}
+
+			for (int third = 1; third < OFFSETS; third++) {
+				for (int fourth = 1; fourth < OFFSETS; fourth++) {
+					for (int motion = -SpeciesThree::MAX_MOTION; motion <= SpeciesThree::MAX_MOTION; motion++) {
+						Openings& next = crossings[leading][third][fourth][motion + SpeciesThree::MAX_MOTION];
+						for (int downbeat = 1; downbeat < OFFSETS; downbeat++) {
+							int move = downbeat + motion - fourth;
+							if (!moveAllowed(move) || leapProblem(fourth - third, move)) continue;
+							// A dissonant last quarter steps on, and a fifth or octave isn't followed by the same
+							if (!isConsonant(leading, fourth) && abs(move) != 1) continue;
+							if (isPerfect(leading, fourth) && downbeat == fourth) continue;
+							for (int second = 1; second < OFFSETS; second++) {
+								if (!leapProblem(move, second - downbeat)) next.set(downbeat * OFFSETS + second);
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	void add(int leading, const int notes[4]) {
+		if (!isConsonant(leading, notes[0])) return;
+		int moves[3];
+		int steps = 0;
+		for (int beat = 0; beat < 3; beat++) {
+			moves[beat] = notes[beat + 1] - notes[beat];
+			if (!moveAllowed(moves[beat])) return;
+			if (abs(moves[beat]) == 1) steps++;
+		}
+		if (leapProblem(moves[0], moves[1]) || leapProblem(moves[1], moves[2])) return;
+
+		// Step down to a dissonance, a third down to a consonance, step up
+		bool cambiata = moves[0] == -1 && moves[1] == -2 && moves[2] == 1 && isConsonant(leading, notes[2]);
+		int dissonances = 0;
+		for (int beat = 1; beat < 4; beat++) {
+			if (!isConsonant(leading, notes[beat])) dissonances++;
+		}
+		// Passing or neighbour tones, except on the third quarter where only passing tones go. The fourth quarter
+		// is left by step at the bar line
+		if (!isConsonant(leading, notes[1]) && !cambiata && !(abs(moves[0]) == 1 && abs(moves[1]) == 1)) return;
+		if (!isConsonant(leading, notes[2]) && !(abs(moves[1]) == 1 && moves[2] == moves[1])) return;
+		if (!isConsonant(leading, notes[3]) && abs(moves[2]) != 1) return;
+
+		Figure& figure = figures[leading][counts[leading]++];
+		for (int beat = 0; beat < 4; beat++) figure.notes[beat] = static_cast<uint8_t>(notes[beat]);
+		figure.weight = static_cast<uint8_t>(1 << steps);
+		figure.dissonances = static_cast<uint8_t>(dissonances);
+		figure.cambiata = cambiata;
+	}
+};
+
+static const FigureTable& figureTable() {
+	static const FigureTable table;
+	return table;
+}
+
+// Openings that can follow figure over a lower voice moving by motion, with no fifths or octaves on both downbeats
+static Openings follows(bool leading, const Figure& figure, int motion) {
+	Openings next = figureTable().crossings[leading][figure.notes[2]][figure.notes[3]][motion + SpeciesThree::MAX_MOTION];
+	if (isPerfect(leading, figure.notes[0])) {
+		for (int second = 0; second < OFFSETS; second++) next.clear(figure.notes[0] * OFFSETS + second);
+	}
+	return next;
+}
+
+// Whether the figure ends a step below the final note without parallels into it
+static bool reachesFinal(bool leading, const Figure& figure, int cadence, int octave) {
+	if (figure.notes[3] != cadence || leapProblem(figure.notes[3] - figure.notes[2], 1)) return false;
+	return !(isPerfect(leading, figure.notes[3]) && octave == figure.notes[3]) && !(isPerfect(leading, figure.notes[0]) && octave == figure.notes[0]);
+}
+
+// Downbeats of the first measure, a fifth or octave above the tonic
+static Openings starts(int lowerNote) {
+	Openings first;
+	for (int note : { 5, 8 }) {
+		int downbeat = note - lowerNote;
+		if (downbeat < 1 || downbeat >= OFFSETS || !isPerfect(isLeadingTone(lowerNote), downbeat)) continue;
+		for (int second = 1; second < OFFSETS; second++) first.set(downbeat * OFFSETS + second);
+	}
+	return first;
+}
+
+SpeciesThree::SpeciesThree(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch) : lower(lowerVoice), viable(scratch) {
+	int length = static_cast<int>(lower.size());
+	if (length < 2) throw runtime_error("The lower voice is too short for a cadence");
+	for (int i = 1; i < length; i++) {
+		if (abs(lower[i] - lower[i - 1]) > MAX_MOTION) throw runtime_error("The lower voice leaps too far for third species");
+	}
+	const FigureTable& table = figureTable();
+
+	// The leading tone on the last quarter, then the octave
+	int cadence = 7 - lower[length - 2];
+	int octave = 8 - lower[length - 1];
+	if (cadence < 1 || cadence >= OFFSETS || octave < 1 || octave >= OFFSETS || !isConsonant(isLeadingTone(lower[length - 1]), octave)) {
+		throw runtime_error("No third species cadence fits this lower voice");
+	}
+	viable.assign((length - 1) * ENDING_WORDS, 0);
+	bool leading = isLeadingTone(lower[length - 2]);
+	for (int f = 0; f < table.counts[leading]; f++) {
+		const Figure& figure = table.figures[leading][f];
+		if (reachesFinal(leading, figure, cadence, octave)) markViable(length - 2, ending(figure));
+	}
+
+	for (int i = length - 3; i >= 0; i--) {
+		bool leadingNext = isLeadingTone(lower[i + 1]);
+		Openings next;
+		for (int f = 0; f < table.counts[leadingNext]; f++) {
+			const Figure& figure = table.figures[leadingNext][f];
+			if (isViable(i + 1, ending(figure))) next.set(opening(figure));
+		}
+		leading = isLeadingTone(lower[i]);
+		for (int f = 0; f < table.counts[leading]; f++) {
+			const Figure& figure = table.figures[leading][f];
+			if (!isViable(i, ending(figure)) && follows(leading, figure, lower[i + 1] - lower[i]).meets(next)) {
+				markViable(i, ending(figure));
+			}
+		}
+	}
+
+	Openings first = starts(lower[0]);
+	leading = isLeadingTone(lower[0]);
+	for (int f = 0; f < table.counts[leading]; f++) {
+		const Figure& figure = table.figures[leading][f];
+		if (first.has(opening(figure)) && isViable(0, ending(figure))) return;
+	}
+	throw runtime_error("No third species upper voice fits this lower voice");
+}
+
+void SpeciesThree::write(Xorshift32& rng, pmr::vector<int>& upperVoice) {
+	const FigureTable& table = figureTable();
+	int length = static_cast<int>(lower.size());
+	upperVoice.reserve(upperVoice.size() + 4 * (length - 1) + 1);
+	dissonances = 0;
+	cambiatas = 0;
+
+	const Figure* previous = nullptr;
+	for (int i = 0; i + 1 < length; i++) {
+		rng.setPosition(i);
+		bool leading = isLeadingTone(lower[i]);
+		Openings allowed = previous == nullptr ? starts(lower[0]) : follows(isLeadingTone(lower[i - 1]), *previous, lower[i] - lower[i - 1]);
+
+		// Weighed, then drawn from, in the same order
+		double total = 0;
+		for (int f = 0; f < table.counts[leading]; f++) {
+			const Figure& figure = table.figures[leading][f];
+			if (allowed.has(opening(figure)) && isViable(i, ending(figure))) total += figure.weight;
+		}
+		double target = rng.nextFloat() * total;
+		const Figure* chosen = nullptr;
+		for (int f = 0; f < table.counts[leading]; f++) {
+			const Figure& figure = table.figures[leading][f];
+			if (!allowed.has(opening(figure)) || !isViable(i, ending(figure))) continue;
+			chosen = &figure;	// The last option catches rounding at the top end
+			if (target < figure.weight) break;
+			target -= figure.weight;
+		}
+
+		for (int beat = 0; beat < 4; beat++) upperVoice.push_back(lower[i] + chosen->notes[beat]);
+		dissonances += chosen->dissonances;
+		cambiatas += chosen->cambiata;
+		previous = chosen;
+	}
+
+	upperVoice.push_back(8);
+}
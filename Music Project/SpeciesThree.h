@@ -0,0 +1,51 @@
+#pragma once
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+using namespace std;
+
+/**
+ * @brief
+ * Third species: four quarter notes in the upper voice against each note of a whole note lower voice.
+ *
+ * Every downbeat is a consonance. A dissonance on a weak beat is approached and left by step, as a passing tone or a
+ * neighbour tone (the third quarter only passes), or is the second note of a cambiata: a step down to the dissonance,
+ * a third down to a consonance, then a step up. Leaps of a fourth or more are recovered by a step the other way, two
+ * leaps never go the same way, no two downbeats in a row (or the last quarter and the next downbeat) are the same
+ * fifth or octave, and the voice stays within a tenth above the lower voice. It ends with the leading tone on the
+ * last quarter before the octave.
+ *
+ * A measure's four notes are a figure, and whether a figure keeps the rules inside its measure depends only on its
+ * steps above the lower note and whether that is a leading tone, so every figure that does is listed once, on first
+ * use. Crossing the bar line depends only on the last two notes, the lower voice's motion and the next figure's first
+ * two, and is tabled the same way. The constructor marks, last measure first, which figure endings can still reach
+ * the cadence, and write() walks forward through them without allocating. It never dead-ends
+ */
+class SpeciesThree {
+public:
+	// Throws runtime_error if no upper voice fits the lower voice
+	SpeciesThree(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch = pmr::get_default_resource());
+
+	// Appends the four quarters of every lower note but the last, then the final note. One draw per lower note but
+	// the last, at its position
+	void write(Xorshift32& rng, pmr::vector<int>& upperVoice);
+
+	// Of the last write()
+	int getDissonances() const { return dissonances; }
+	int getCambiatas() const { return cambiatas; }
+
+	static const int OFFSET_COUNT = 10;		// Scale steps above the lower note, unison to a tenth
+	static const int MAX_MOTION = 12;		// Furthest the lower voice may move between notes, in scale steps
+	static const int ENDING_WORDS = 16;		// One bit per (downbeat, third quarter, fourth quarter), 1000 of them
+
+private:
+	const pmr::vector<int>& lower;
+	// ENDING_WORDS words per measure, the figure endings that can still reach the cadence
+	pmr::vector<uint64_t> viable;
+	int dissonances = 0;
+	int cambiatas = 0;
+
+	bool isViable(int measure, int ending) const { return viable[measure * ENDING_WORDS + ending / 64] >> (ending % 64) & 1; }
+	void markViable(int measure, int ending) { viable[measure * ENDING_WORDS + ending / 64] |= uint64_t(1) << (ending % 64); }
+};
@@ -1,37 +1,201 @@
 #include "SpeciesTwo.h"
+#include "IntervalRules.h"
+#include <cstdlib>
+#include <stdexcept>
 
+const int OFFSETS = SpeciesTwo::OFFSET_COUNT;
+const int MOTIONS = 2 * SpeciesTwo::MAX_MOTION + 1;
+const int STATE_WORDS = SpeciesTwo::STATE_WORDS;
 
+// A set of (strong, weak) states, one bit each
+struct BeatPairs {
+	uint64_t bits[STATE_WORDS] = {};
 
-SpeciesTwo::SpeciesTwo()
-{
+	bool has(int state) const { return bits[state / 64] >> (state % 64) & 1; }
+	void set(int state) { bits[state / 64] |= uint64_t(1) << (state % 64); }
+	bool empty() const { return (bits[0] | bits[1]) == 0; }
+	BeatPairs operator&(const BeatPairs& other) const {
+		BeatPairs both;
+		for (int word = 0; word < STATE_WORDS; word++) both.bits[word] = bits[word] & other.bits[word];
+		return both;
+	}
+	BeatPairs operator|(const BeatPairs& other) const {
+		BeatPairs either;
+		for (int word = 0; word < STATE_WORDS; word++) either.bits[word] = bits[word] | other.bits[word];
+		return either;
+	}
+};
+
+static int state(int strong, int weak) {
+	return strong * OFFSETS + weak;
 }
 
+struct WeakBeatTable {
+	// [leading tone below] states that keep the rules over one lower note. A dissonant weak beat is approached by
+	// step here and left by step in the successors
+	BeatPairs states[2];
+	// [leading tone below][strong][weak][lower motion + MAX_MOTION] states over the next lower note that can follow,
+	// before that note's own leading tone is applied by masking with states[]
+	BeatPairs successors[2][OFFSETS][OFFSETS][MOTIONS];
+	// The same, without the leap rules across the bar line, for lower voices that leave no other way
+	BeatPairs breaks[2][OFFSETS][OFFSETS][MOTIONS];
 
-SpeciesTwo::~SpeciesTwo()
-{
-}
+	WeakBeatTable() {
+		for (int leading = 0; leading < 2; leading++) {
+			for (int strong = 1; strong < OFFSETS; strong++) {
+				for (int weak = 1; weak < OFFSETS; weak++) {
+					int inside = weak - strong;
+					if (!isConsonant(leading, strong) || !moveAllowed(inside)) continue;
+					if (!isConsonant(leading, weak) && abs(inside) != 1) continue;
+					states[leading].set(state(strong, weak));
 
-int SpeciesTwo::chooseNextNote() {
-	if ((noteTwoBefore - noteBefore) == 2) {
-		return noteBefore + 1;
-	}
-	else if ((noteTwoBefore - noteBefore) == -2) {
-		return noteTwoBefore + 1;
+					for (int motion = -SpeciesTwo::MAX_MOTION; motion <= SpeciesTwo::MAX_MOTION; motion++) {
+						BeatPairs& next = successors[leading][strong][weak][motion + SpeciesTwo::MAX_MOTION];
+						BeatPairs& broken = breaks[leading][strong][weak][motion + SpeciesTwo::MAX_MOTION];
+						for (int nextStrong = 1; nextStrong < OFFSETS; nextStrong++) {
+							int across = nextStrong + motion - weak;
+							if (!moveAllowed(across)) continue;
+							if (!isConsonant(leading, weak) && abs(across) != 1) continue;
+							// No fifth or octave on both strong beats, or from the weak beat straight into the same
+							if (isPerfect(leading, strong) && nextStrong == strong) continue;
+							if (isPerfect(leading, weak) && nextStrong == weak) continue;
+							for (int nextWeak = 1; nextWeak < OFFSETS; nextWeak++) {
+								broken.set(state(nextStrong, nextWeak));
+								if (!leapProblem(inside, across) && !leapProblem(across, nextWeak - nextStrong)) next.set(state(nextStrong, nextWeak));
+							}
+						}
+					}
+				}
+			}
+		}
 	}
-	else if ((noteTwoBefore - noteBefore) == 1) {
-		// This would normally be an error but I'm making up rules because to fix the error would require rewriting from here on out of both the top and bottom line
-		return noteTwoBefore + 1;
+};
+
+static const WeakBeatTable& weakBeatTable() {
+	static const WeakBeatTable table;
+	return table;
+}
+
+static BeatPairs load(const uint64_t* words) {
+	BeatPairs states;
+	for (int word = 0; word < STATE_WORDS; word++) states.bits[word] = words[word];
+	return states;
+}
+
+// States over the next lower note that can follow index and are viable in next, or in fewer, reached by breaking the
+// leap rules, when there is a layer below
+static BeatPairs follows(bool leading, int index, int motion, const uint64_t* next, const uint64_t* fewer) {
+	const WeakBeatTable& table = weakBeatTable();
+	BeatPairs states = table.successors[leading][index / OFFSETS][index % OFFSETS][motion] & load(next);
+	if (fewer != nullptr) states = states | (table.breaks[leading][index / OFFSETS][index % OFFSETS][motion] & load(fewer));
+	return states;
+}
+
+// States over the first lower note, a fifth or octave above the tonic on the strong beat
+static BeatPairs starts(int lowerNote) {
+	const WeakBeatTable& table = weakBeatTable();
+	bool leading = isLeadingTone(lowerNote);
+	BeatPairs first;
+	for (int note : { 5, 8 }) {
+		int strong = note - lowerNote;
+		if (strong < 1 || strong >= OFFSETS || !isPerfect(leading, strong)) continue;
+		for (int weak = 1; weak < OFFSETS; weak++) {
+			if (table.states[leading].has(state(strong, weak))) first.set(state(strong, weak));
+		}
 	}
-	else if ((noteTwoBefore - noteBefore) == -1) {
-		return noteTwoBefore - 1;
+	return first;
+}
+
+SpeciesTwo::SpeciesTwo(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch) : lower(lowerVoice), viable(scratch) {
+	int length = static_cast<int>(lower.size());
+	if (length < 2) throw runtime_error("The lower voice is too short for a cadence");
+	for (int i = 1; i < length; i++) {
+		if (abs(lower[i] - lower[i - 1]) > MAX_MOTION) throw runtime_error("The lower voice leaps too far for second species");
 	}
-	else if ((noteTwoBefore - noteBefore) < 0) {
-		return noteBefore + 1;
+	const WeakBeatTable& table = weakBeatTable();
+
+	// The leading tone on the last weak beat, then the octave, with no fifth or octave into it
+	int cadence = 7 - lower[length - 2];
+	int octave = 8 - lower[length - 1];
+	if (cadence < 1 || cadence >= OFFSETS || octave < 1 || octave >= OFFSETS || !isConsonant(isLeadingTone(lower[length - 1]), octave)) {
+		throw runtime_error("No second species cadence fits this lower voice");
 	}
-	else if ((noteTwoBefore - noteBefore) > 0) {
-		return noteBefore - 1;
+	BeatPairs first = starts(lower[0]);
+
+	// Layer k holds the states that reach the cadence breaking the leap rules at k crossings at most, the cadence
+	// itself counting as one. Layers are added until the opening reaches it, so write() breaks them as little as
+	// the lower voice allows
+	for (leapBreaks = 0; leapBreaks <= length; leapBreaks++) {
+		viable.resize(viable.size() + (length - 1) * STATE_WORDS, 0);
+		bool leading = isLeadingTone(lower[length - 2]);
+		for (int strong = 1; strong < OFFSETS; strong++) {
+			if (!table.states[leading].has(state(strong, cadence))) continue;
+			if ((isPerfect(leading, cadence) && octave == cadence) || (isPerfect(leading, strong) && octave == strong)) continue;
+			if (leapBreaks == 0 && leapProblem(cadence - strong, 1)) continue;
+			markViable(leapBreaks, length - 2, state(strong, cadence));
+		}
+
+		for (int i = length - 3; i >= 0; i--) {
+			leading = isLeadingTone(lower[i]);
+			int motion = lower[i + 1] - lower[i] + MAX_MOTION;
+			for (int index = 0; index < STATE_COUNT; index++) {
+				if (!table.states[leading].has(index)) continue;
+				const uint64_t* fewer = leapBreaks > 0 ? viableAt(leapBreaks - 1, i + 1) : nullptr;
+				if (!follows(leading, index, motion, viableAt(leapBreaks, i + 1), fewer).empty()) markViable(leapBreaks, i, index);
+			}
+		}
+
+		if (!(first & load(viableAt(leapBreaks, 0))).empty()) return;
 	}
-	else {
-		return noteTwoBefore + 1;
+	throw runtime_error("No second species upper voice fits this lower voice");
+}
+
+void SpeciesTwo::write(Xorshift32& rng, pmr::vector<int>& upperVoice) {
+	int length = static_cast<int>(lower.size());
+	upperVoice.reserve(upperVoice.size() + 2 * length - 1);
+	dissonances = 0;
+
+	int layer = leapBreaks;
+	int previous = 0;
+	for (int i = 0; i + 1 < length; i++) {
+		rng.setPosition(i);
+		BeatPairs options;
+		BeatPairs kept;			// Options that keep the leap rules across the bar line
+		if (i == 0) {
+			options = kept = starts(lower[0]) & load(viableAt(layer, 0));
+		}
+		else {
+			bool leading = isLeadingTone(lower[i - 1]);
+			int motion = lower[i] - lower[i - 1] + MAX_MOTION;
+			options = follows(leading, previous, motion, viableAt(layer, i), layer > 0 ? viableAt(layer - 1, i) : nullptr);
+			kept = follows(leading, previous, motion, viableAt(layer, i), nullptr);
+		}
+
+		// Steps are favoured over leaps, both into the strong beat and on to the weak one
+		int weak = previous % OFFSETS;
+		double weights[STATE_COUNT] = {};
+		double total = 0;
+		for (int index = 0; index < STATE_COUNT; index++) {
+			if (!options.has(index)) continue;
+			int steps = (abs(index % OFFSETS - index / OFFSETS) == 1) + (i > 0 && abs(lower[i] + index / OFFSETS - (lower[i - 1] + weak)) == 1);
+			weights[index] = 1 << steps;
+			total += weights[index];
+		}
+		double target = rng.nextFloat() * total;
+		int chosen = 0;
+		for (int index = 0; index < STATE_COUNT; index++) {
+			if (weights[index] == 0) continue;
+			chosen = index;		// The last option catches rounding at the top end
+			if (target < weights[index]) break;
+			target -= weights[index];
+		}
+
+		if (!kept.has(chosen)) layer--;
+		upperVoice.push_back(lower[i] + chosen / OFFSETS);
+		upperVoice.push_back(lower[i] + chosen % OFFSETS);
+		if (!isConsonant(isLeadingTone(lower[i]), chosen % OFFSETS)) dissonances++;
+		previous = chosen;
 	}
+
+	upperVoice.push_back(8);
 }
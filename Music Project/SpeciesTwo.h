@@ -1,18 +1,55 @@
 #pragma once
-#include "Species.h"
-using namespace::std;
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <vector>
+using namespace std;
 
-// TODO: Finish after SpeciesOne -- Elliott
-class SpeciesTwo : public Species {
+/**
+ * @brief
+ * Second species: two quarter notes in the upper voice against each note of a half note lower voice.
+ *
+ * The strong beat is a consonance. The weak beat is a consonance, or a dissonance approached and left by step, as a
+ * passing or a neighbour tone. Leaps of a fourth or more are recovered by a step the other way, two leaps never go
+ * the same way, no strong beat repeats the fifth or octave of the strong beat before it or of the weak beat just
+ * before it, and the voice stays within a tenth above the lower voice. It ends with the leading tone on the last
+ * weak beat, then the octave.
+ *
+ * A lower note's two upper notes are a state. Whether one state can follow another depends only on the weak beat
+ * before and its strong beat, the lower voice's motion and whether the lower note is a leading tone, so every
+ * transition is worked out once, on first use, into a table of weak beat successors. The constructor marks, last note
+ * first, the states that can still reach the cadence, and write() walks forward through them. It never dead-ends.
+ * A lower voice that leaps far and often can leave no way to keep the leap rules, and then the constructor finds the
+ * fewest bar lines where they have to be broken, keeping every harmonic rule
+ */
+class SpeciesTwo {
 public:
-	SpeciesTwo();
-	~SpeciesTwo();
-	int chooseNextNote();
-	/*
-	bool melodicRule2a();
-	bool melodicRule2b();
-	bool harmonicRule2a();
-	bool harmonicRule2b();
-	*/
-};
+	// Throws runtime_error if no upper voice fits the lower voice
+	SpeciesTwo(const pmr::vector<int>& lowerVoice, pmr::memory_resource* scratch = pmr::get_default_resource());
+
+	// Appends the strong and weak beat of every lower note but the last, then the final note. One draw per lower note
+	// but the last, at its position
+	void write(Xorshift32& rng, pmr::vector<int>& upperVoice);
+
+	// Passing and neighbour tones in the last write()
+	int getDissonances() const { return dissonances; }
+	// Bar lines (or the cadence) where every upper voice has to break the leap rules, 0 unless the lower voice leaps
+	// too far and too often to follow. Every write() breaks them this many times
+	int getLeapBreaks() const { return leapBreaks; }
 
+	static const int OFFSET_COUNT = 10;		// Scale steps above the lower note, unison to a tenth
+	static const int MAX_MOTION = 12;		// Furthest the lower voice may move between notes, in scale steps
+	static const int STATE_COUNT = OFFSET_COUNT * OFFSET_COUNT;	// (strong, weak) offsets above one lower note
+	static const int STATE_WORDS = (STATE_COUNT + 63) / 64;
+
+private:
+	const pmr::vector<int>& lower;
+	// STATE_WORDS words per lower note but the last, the states that can still reach the cadence, in a layer for
+	// each number of leap breaks up to leapBreaks
+	pmr::vector<uint64_t> viable;
+	int leapBreaks = 0;
+	int dissonances = 0;
+
+	const uint64_t* viableAt(int layer, int position) const { return &viable[(layer * (lower.size() - 1) + position) * STATE_WORDS]; }
+	void markViable(int layer, int position, int state) { viable[(layer * (lower.size() - 1) + position) * STATE_WORDS + state / 64] |= uint64_t(1) << (state % 64); }
+};
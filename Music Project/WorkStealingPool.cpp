@@ -0,0 +1,99 @@
+#include "WorkStealingPool.h"
+
+// Pool and worker index of the calling thread, so a task's own submissions stay on its worker
+static thread_local WorkStealingPool* currentPool = nullptr;
+static thread_local int currentWorker = -1;
+
+WorkStealingPool::WorkStealingPool(int threadCount) {
+	if (threadCount <= 0) threadCount = static_cast<int>(thread::hardware_concurrency());
+	if (threadCount <= 0) threadCount = 1;
+	for (int i = 0; i < threadCount; i++) {
+		workers.push_back(make_unique<Worker>());
+	}
+	for (int i = 0; i < threadCount; i++) {
+		threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+	}
+}
+
+WorkStealingPool::~WorkStealingPool() {
+	{
+		lock_guard<mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wake.notify_all();
+	for (auto& worker : threads) {
+		worker.join();
+	}
+}
+
+void WorkStealingPool::submit(function<void()> task) {
+	int target = currentPool == this ? currentWorker : static_cast<int>(nextWorker++ % workers.size());
+	pending++;
+	{
+		lock_guard<mutex> guard(workers.at(target)->lock);
+		workers.at(target)->tasks.push_back(move(task));
+	}
+	{
+		// Counting under sleepLock means a worker can't check for work and fall asleep in between
+		lock_guard<mutex> guard(sleepLock);
+		queued++;
+	}
+	wake.notify_one();
+}
+
+void WorkStealingPool::wait() {
+	unique_lock<mutex> guard(sleepLock);
+	idle.wait(guard, [this] { return pending == 0; });
+	if (firstError) {
+		exception_ptr error = firstError;
+		firstError = nullptr;
+		rethrow_exception(error);
+	}
+}
+
+bool WorkStealingPool::runOne(int self) {
+	function<void()> task;
+	// Newest task of our own first, it is the one most likely still in cache
+	{
+		lock_guard<mutex> guard(workers.at(self)->lock);
+		if (!workers.at(self)->tasks.empty()) {
+			task = move(workers.at(self)->tasks.back());
+			workers.at(self)->tasks.pop_back();
+		}
+	}
+	// Otherwise steal the oldest task of the next worker that has one
+	for (size_t i = 1; !task && i < workers.size(); i++) {
+		Worker& victim = *workers.at((self + i) % workers.size());
+		lock_guard<mutex> guard(victim.lock);
+		if (!victim.tasks.empty()) {
+			task = move(victim.tasks.front());
+			victim.tasks.pop_front();
+		}
+	}
+	if (!task) return false;
+
+	queued--;
+	try {
+		task();
+	}
+	catch (...) {
+		lock_guard<mutex> guard(sleepLock);
+		if (!firstError) firstError = current_exception();
+	}
+	if (--pending == 0) {
+		lock_guard<mutex> guard(sleepLock);
+		idle.notify_all();
+	}
+	return true;
+}
+
+void WorkStealingPool::workerLoop(int self) {
+	currentPool = this;
+	currentWorker = self;
+	while (true) {
+		if (runOne(self)) continue;
+		unique_lock<mutex> guard(sleepLock);
+		wake.wait(guard, [this] { return stopping || queued > 0; });
+		if (stopping && queued == 0) return;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Fixed set of worker threads, each with its own task deque. A worker runs its newest task first and, when its
+// deque is empty, steals the oldest task from another worker, so uneven jobs still keep every core busy.
+// Tasks submitted from outside the pool are dealt out round-robin, tasks submitted by a task go to its own worker.
+class WorkStealingPool {
+public:
+	// 0 threads means one per hardware thread
+	explicit WorkStealingPool(int threads = 0);
+	~WorkStealingPool();
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	int size() const { return static_cast<int>(workers.size()); }
+	void submit(function<void()> task);
+	// Blocks until every submitted task has finished, then rethrows the first exception a task threw (if any)
+	void wait();
+
+private:
+	struct Worker {
+		mutex lock;
+		deque<function<void()>> tasks;
+	};
+	vector<unique_ptr<Worker>> workers;
+	vector<thread> threads;
+
+	mutex sleepLock;				// Guards sleeping and waking, and queued/pending changes that wake someone
+	condition_variable wake;		// Workers wait here for tasks
+	condition_variable idle;		// wait() waits here for pending to reach 0
+	atomic<int> queued{0};			// Submitted but not yet started
+	atomic<int> pending{0};			// Submitted but not yet finished
+	atomic<unsigned> nextWorker{0};
+	bool stopping = false;
+	exception_ptr firstError;
+
+	bool runOne(int self);
+	void workerLoop(int self);
+};
@@ -1,30 +1,99 @@
 #include "WritePhrase.h"
 #include "SpeciesTwo.h"
 #include "SpeciesOne.h"
-#include "xorshift32.h"
+#include "SpeciesOneTable.h"
+#include "SpeciesKernel.h"
+#include "SpeciesOneUniform.h"
+#include "SpeciesThree.h"
+#include "SpeciesFour.h"
+#include "SpeciesFive.h"
+#include "SpeciesOneVoices.h"
+#include "BeamSearch.h"
 #include <iostream>
 #include "GenerateLowerVoice.h"
+#include "CantusFirmus.h"
 #include <string>
+#include <algorithm>
+#include <atomic>
+#include <stdexcept>
 
-WritePhrase::WritePhrase(string key, int phraseLength) {
-	this->key = key;
+WritePhrase::WritePhrase(string key, int phraseLength, Xorshift32& rng, pmr::memory_resource* scratch)
+	: lowerRng(&rng), upperRng(&rng), scratch(scratch), upperVoiceI(scratch), lowerVoiceI(scratch), middleVoicesI(scratch) {
+	this->key = parseKey(key);
 	this->phraseLength = phraseLength;
 }
 
-WritePhrase::WritePhrase(string key, int phraseLength, int speciesType, int beatsPerMeasure) {
-	this->key = key;
+WritePhrase::WritePhrase(string key, int phraseLength, int speciesType, int beatsPerMeasure, Xorshift32& rng, pmr::memory_resource* scratch)
+	: lowerRng(&rng), upperRng(&rng), scratch(scratch), upperVoiceI(scratch), lowerVoiceI(scratch), middleVoicesI(scratch) {
+	this->key = parseKey(key);
 	this->phraseLength = phraseLength;
 	this->speciesType = speciesType;
 	this->beatsPerMeasure = beatsPerMeasure;
 }
 
-void WritePhrase::setSeed(int seed) {
-	Xorshift32::seed(static_cast<uint32_t>(seed));
+static atomic<uint64_t> totalBacktracks(0);
+static atomic<uint64_t> totalFailures(0);
+
+BacktrackStats WritePhrase::getTotalBacktrackStats() {
+	BacktrackStats totals;
+	totals.backtracks = totalBacktracks;
+	totals.failures = totalFailures;
+	return totals;
+}
+
+string engineName(SpeciesOneEngine engine) {
+	switch (engine) {
+	case Engine_Rules:
+		return "rules";
+	case Engine_Table:
+		return "table";
+	case Engine_Composed:
+		return "composed";
+	case Engine_Uniform:
+		return "uniform";
+	default:
+		return "beam";
+	}
+}
+
+SpeciesOneEngine parseEngine(const string& name) {
+	for (SpeciesOneEngine engine : { Engine_Rules, Engine_Table, Engine_Composed, Engine_Uniform, Engine_Beam }) {
+		if (name == engineName(engine)) return engine;
+	}
+	throw runtime_error("Unknown engine: " + name + " (use rules, table, composed, uniform or beam)");
+}
+
+string lowerVoiceName(LowerVoiceSource source) {
+	return source == Lower_Cantus ? "cantus" : "walk";
+}
+
+LowerVoiceSource parseLowerVoice(const string& name) {
+	for (LowerVoiceSource source : { Lower_Walk, Lower_Cantus }) {
+		if (name == lowerVoiceName(source)) return source;
+	}
+	throw runtime_error("Unknown lower voice: " + name + " (use walk or cantus)");
+}
+
+string speciesTwoName(SpeciesTwoEngine engine) {
+	return engine == Two_Derived ? "derived" : "rules";
+}
+
+SpeciesTwoEngine parseSpeciesTwo(const string& name) {
+	for (SpeciesTwoEngine engine : { Two_Rules, Two_Derived }) {
+		if (name == speciesTwoName(engine)) return engine;
+	}
+	throw runtime_error("Unknown second species engine: " + name + " (use rules or derived)");
+}
+
+void checkMeter(int speciesType, int beatsPerMeasure) {
+	if ((speciesType == 3 || speciesType == 5) && beatsPerMeasure != 4) {
+		throw runtime_error("Species " + to_string(speciesType) + " is only written with 4 beats to the measure, not " + to_string(beatsPerMeasure));
+	}
 }
 
 // THIS IS WHERE THE MAGIC HAPPENS (along with everywhere else)
 
-Phrase WritePhrase::getPhrase() {
+const Phrase& WritePhrase::getPhrase() {
 	// Set key and time signature for phrase before returning it
 	phraseN.setKey(getKey());
 	phraseN.setTimeSignature(getTimeSignature());
@@ -32,9 +101,35 @@ Phrase WritePhrase::getPhrase() {
 }
 
 void WritePhrase::writeThePhrase() {
-	if (speciesType == 0) {
-		SpeciesOne imitative;
-		imitative.writeImitativeTwoVoices(phraseLength * beatsPerMeasure);
+	// Every species writes at most one note per beat in each voice, plus the imitative pickup, except that fifth
+	// species' eighths can add one more every four beats
+	size_t maxNotes = phraseLength * beatsPerMeasure + 1;
+	if (speciesType == 5) maxNotes += maxNotes / 4;
+	if (voiceCount < 2 || voiceCount > SpeciesOneVoices::MAX_VOICES) {
+		throw runtime_error("A phrase takes 2 to " + to_string(SpeciesOneVoices::MAX_VOICES) + " voices, not " + to_string(voiceCount));
+	}
+	checkMeter(speciesType, beatsPerMeasure);
+	phraseN.setVoiceCount(voiceCount);
+	phraseN.reserve(maxNotes);
+	upperVoiceI.reserve(maxNotes);
+	lowerVoiceI.reserve(maxNotes);
+
+	if (voiceCount > 2) {
+		if (speciesType != 1) {
+			throw runtime_error("Species " + to_string(speciesType) + " is only written for two voices, not " + to_string(voiceCount));
+		}
+		writeVoices();
+	}
+	else if (speciesType == 0) {
+		SpeciesOne imitative(*lowerRng, scratch);
+		if (engine == Engine_Beam) {
+			pmr::vector<int> beamLower(scratch);
+			BeamSearch(beamOptions, scratch).writeImitativeLower(phraseLength * beatsPerMeasure, *lowerRng, beamLower);
+			imitative.writeImitativeTwoVoices(beamLower);
+		}
+		else {
+			imitative.writeImitativeTwoVoices(phraseLength * beatsPerMeasure);
+		}
 		lowerVoiceI = imitative.getImitativeLower();
 		upperVoiceI = imitative.getImitativeUpper();
 		upperVoiceI.emplace(upperVoiceI.begin(), 1);
@@ -46,6 +141,15 @@ void WritePhrase::writeThePhrase() {
 	else if (speciesType == 2) {
 		writeUpperVoiceTwo();
 	}
+	else if (speciesType == 3) {
+		writeUpperVoiceThree();
+	}
+	else if (speciesType == 4) {
+		writeUpperVoiceFour();
+	}
+	else if (speciesType == 5) {
+		writeUpperVoiceFive();
+	}
 	else {
 		if (speciesType != 1) {
 			cout << "Species unintelligible. Converting to Species 1" << endl;
@@ -71,17 +175,15 @@ void WritePhrase::printPhraseI() {
 void WritePhrase::printPhraseN() {
 	cout << "Phrase in Notes: " << endl;
 	cout << "Top   : ";
-	//	vector<Note*> upperVoiceN;
-	//	NoteType getNote() { return note; }
 	cout << Note_C4 << " | ";
-	for (Note* i : phraseN.getUpperVoice()) {
-		NoteType type = i->getNote();
-		cout << type << " ";
-		//cout << i->getNote() << " ";
+	const Voice& upperVoice = phraseN.getUpperVoice();
+	for (size_t i = 0; i < upperVoice.size(); i++) {
+		cout << upperVoice.pitchAt(i) << " ";
 	}
 	cout << endl << "Bottom: ";
-	for (Note* i : phraseN.getLowerVoice()) {
-		cout << i->getNote() << " ";
+	const Voice& lowerVoice = phraseN.getLowerVoice();
+	for (size_t i = 0; i < lowerVoice.size(); i++) {
+		cout << lowerVoice.pitchAt(i) << " ";
 	}
 	cout << endl;
 }
@@ -104,45 +206,7 @@ void WritePhrase::calculateInterval() {
 }
 
 string WritePhrase::getKey() {
-	if (key == "C") {
-		return "c";
-	}
-	else if (key == "Db") {
-		return "des";
-	}
-	else if (key == "D") {
-		return "d";
-	}
-	else if (key == "Eb") {
-		return "ees";
-	}
-	else if (key == "E") {
-		return "e";
-	}
-	else if (key == "F") {
-		return "f";
-	}
-	else if (key == "F#") {
-		return "fis";
-	}
-	else if (key == "G") {
-		return "g";
-	}
-	else if (key == "Ab") {
-		return "aes";
-	}
-	else if (key == "A") {
-		return "a";
-	}
-	else if (key == "Bb") {
-		return "bes";
-	}
-	else if (key == "B") {
-		return "b";
-	}
-	else {
-		throw runtime_error("Cannot convert key to LilyPond");
-	}
+	return KEYS[key].lilyPondName;
 }
 
 string WritePhrase::getTimeSignature() {
@@ -162,139 +226,151 @@ string WritePhrase::getTimeSignature() {
 	}
 }
 
-Note* WritePhrase::convertIntToNote(int num) {
+Note WritePhrase::convertIntToNote(int num) {
 	Note key = convertKeyToNote();
 	int computeNext = convertScaleDegreeToHalfStep(num) + key.getNote();
 	NoteType val = static_cast<NoteType>(computeNext);
-	Note* test = new Note(val, 4);
-	return test;
+	return Note(val, 4);
 }
 
-Note* WritePhrase::convertIntToNoteTwo(int num) {
+Note WritePhrase::convertIntToNoteTwo(int num) {
 	Note key = convertKeyToNote();
 	int computeNext = convertScaleDegreeToHalfStep(num) + key.getNote();
 	NoteType val = static_cast<NoteType>(computeNext);
-	Note* test = new Note(val, 2);
-	return test;
+	return Note(val, 2);
 }
 
 int WritePhrase::convertScaleDegreeToHalfStep(int scaleDegree) {
-	int halfStep;
-	int expression = (((scaleDegree - 1) % 7) + 1);
-	if (expression <= 0) {
-		expression += 7;
-	}							  
-	switch (expression) {
-		case 1:
-			halfStep = 0;
-			break;
-		case 2:
-			halfStep = 2;
-			break;
-		case 3:
-			halfStep = 4;
-			break;
-		case 4:
-			halfStep = 5;
-			break;
-		case 5:
-			halfStep = 7;
-			break;
-		case 6:
-			halfStep = 9;
-			break;
-		case 7:
-			halfStep = 11;
-			break;
-		default: // Because of modulo arithmetic, this should never happen
-			halfStep = 99;
-			cout << "Could not convert scale degree " << scaleDegree << " to half step! Expression: " << expression << endl;
-			//throw runtime_error("Could not convert scale degree to half step!");
-	}
-	// Use floor-division to match TS Math.floor((scaleDegree - 1) / 7)
-	int sd = scaleDegree - 1;
-	int octave = sd >= 0 ? sd / 7 : (sd - 6) / 7;
-	return octave * 12 + halfStep;
+	return scaleDegreeToHalfStep(scaleDegree);
 }
 
 Note WritePhrase::convertKeyToNote() {
-	if (key == "C") {		// C, Db, D, Eb, E, F, F#, G, Ab, A, Bb, B
-		return Note(Note_C4);
-	}
-	else if (key == "Db") {
-		return Note(Note_D4_flat);
-	}
-	else if (key == "D") {
-		return Note(Note_D4);
-	}
-	else if (key == "Eb") {
-		return Note(Note_E4_flat);
-	}
-	else if (key == "E") {
-		return Note(Note_E4);
-	}
-	else if (key == "F") {
-		return Note(Note_F4);
-	}
-	else if (key == "F#") {
-		return Note(Note_F4_sharp);
-	}
-	else if (key == "G") {
-		return Note(Note_G4);
-	}
-	else if (key == "Ab") {
-		return Note(Note_A3_flat);
-	}
-	else if (key == "A") {
-		return Note(Note_A3);
-	}
-	else if (key == "Bb") {
-		return Note(Note_B3_flat);
+	return Note(KEYS[key].tonic);
+}
+
+void WritePhrase::writeLowerVoice() {
+	chooseLowerVoice(phraseLength * beatsPerMeasure);
+	for (auto i : lowerVoiceI) {
+		phraseN.addNoteToLowerVoice(convertIntToNote(i));
 	}
-	else if (key == "B") {
-		return Note(Note_B3);
+}
+
+void WritePhrase::chooseLowerVoice(int length) {
+	if (lowerVoice == Lower_Cantus) {
+		chooseCantus(length);
 	}
 	else {
-		throw runtime_error("Cannot convert key to note!");
+		GenerateLowerVoice lower(*lowerRng, length, scratch);
+		lowerVoiceI = lower.getLowerVoice();
 	}
 }
 
-void WritePhrase::writeLowerVoice() {
-	GenerateLowerVoice lower(phraseLength * beatsPerMeasure);
-	lowerVoiceI = lower.getLowerVoice();
-	for (auto i : lowerVoiceI) {
-		phraseN.addNoteToLowerVoice(convertIntToNote(i));
+void WritePhrase::chooseCantus(int length) {
+	if (cantusLibrary == nullptr || !cantusLibrary->pick(length, *lowerRng, lowerVoiceI)) {
+		CantusFirmus cantus(*lowerRng, length, scratch);
+		lowerVoiceI = cantus.getNotes();
 	}
 }
 
 void WritePhrase::writeUpperVoiceOne() {
-	if (Xorshift32::nextFloat() < 0.5) {
-		upperVoiceI.push_back(5);
+	if (engine == Engine_Uniform) {
+		SpeciesOneUniform uniform(lowerVoiceI, scratch);
+		uniform.sample(*upperRng, upperVoiceI);
 	}
-	else {
-		upperVoiceI.push_back(8);
+	else if (engine == Engine_Beam) {
+		BeamSearch(beamOptions, scratch).writeFirstSpecies(lowerVoiceI, *upperRng, upperVoiceI);
 	}
-	for (int i = 1; i < lowerVoiceI.size() -2; i++) {
-		SpeciesOne one;
-		one.setNoteBefore(upperVoiceI.at(i - 1));
-		one.setNoteBelow(lowerVoiceI.at(i));
-		one.setNoteBeforeAndBelow(lowerVoiceI.at(i - 1));
-		if (i >= 2) {
-			one.setNoteTwoBefore(upperVoiceI.at(i - 2));
+	else {
+		upperRng->setPosition(0);
+		if (upperRng->nextFloat() < 0.5) {
+			upperVoiceI.push_back(5);
+		}
+		else {
+			upperVoiceI.push_back(8);
+		}
+		if (engine == Engine_Table) {
+			SpeciesOneTable table(*upperRng);
+			writeUpperVoiceOneWith(table);
 		}
-		int nextNote = one.chooseNextNote();
-		upperVoiceI.push_back(nextNote);
+		else if (engine == Engine_Composed) {
+			SpeciesKernel<FirstSpeciesRules> kernel(*upperRng);
+			writeUpperVoiceOneWith(kernel);
+		}
+		else {
+			SpeciesOne one(*upperRng, scratch);
+			writeUpperVoiceOneWith(one);
+		}
+		upperVoiceI.push_back(7);
+		upperVoiceI.push_back(8);
 	}
-	upperVoiceI.push_back(7);
-	upperVoiceI.push_back(8);
 	for (auto i : upperVoiceI) {
 		phraseN.addNoteToUpperVoice(convertIntToNote(i));
 	}
 }
 
+template <class Engine>
+void WritePhrase::writeUpperVoiceOneWith(Engine& engine) {
+	// Depth first: a note is only undone when the one after it has nothing left to try. Without dead ends this makes
+	// exactly the draws and choices of choosing each note once
+	int end = static_cast<int>(lowerVoiceI.size()) - 2;
+	pmr::vector<uint32_t> tried(max(end, 1), 0, scratch);	// Options already given up on at each position
+	int furthest = 1;
+	int undone = 0;
+	int i = 1;
+	while (i < end) {
+		engine.setPosition(i);
+		engine.setNoteBefore(upperVoiceI[i - 1]);
+		engine.setNoteBelow(lowerVoiceI[i]);
+		engine.setNoteBeforeAndBelow(lowerVoiceI[i - 1]);
+		if (i >= 2) {
+			engine.setNoteTwoBefore(upperVoiceI[i - 2]);
+		}
+		uint32_t options = engine.allowedOptions() & ~tried[i];
+
+		if (options == 0) {
+			// Undo the note before and rule it out, the first note (5 or 8) is never undone
+			if (i == 1 || ++undone > stepBudget || furthest - (i - 1) > maxDepth) {
+				backtrackStats.failures++;
+				totalFailures++;
+				throw runtime_error("No first species upper voice found within the backtracking limits (" + to_string(backtrackStats.backtracks)
+					+ " notes undone, stuck at note " + to_string(i) + ")");
+			}
+			backtrackStats.backtracks++;
+			totalBacktracks++;
+			tried[i] = 0;
+			i--;
+			tried[i] |= optionBit(upperVoiceI[i] - lowerVoiceI[i] + 1);
+			upperVoiceI.pop_back();
+			continue;
+		}
+
+		// A retry at this position takes the draw after the ones already used here
+		upperRng->setPosition(i, countOptions(tried[i]));
+		upperVoiceI.push_back(lowerVoiceI[i] + nthOption(options, upperRng->nextInt(countOptions(options))));
+		i++;
+		furthest = max(furthest, i);
+	}
+}
+
 void WritePhrase::writeUpperVoiceTwo() {
+	if (speciesTwo == Two_Rules) {
+		// A half note lower voice, with two quarter notes above each of its notes but the last
+		chooseLowerVoice(phraseLength * beatsPerMeasure / 2);
+		for (auto i : lowerVoiceI) {
+			phraseN.addNoteToLowerVoice(convertIntToNoteTwo(i));
+		}
+
+		SpeciesTwo two(lowerVoiceI, scratch);
+		two.write(*upperRng, upperVoiceI);
+		for (size_t i = 0; i + 1 < upperVoiceI.size(); i++) {
+			phraseN.addNoteToUpperVoice(convertIntToNote(upperVoiceI[i]));
+		}
+		phraseN.addNoteToUpperVoice(convertIntToNoteTwo(upperVoiceI.back()));
+		return;
+	}
+
 	//	Writes the Lower voice
-	SpeciesOne imitative;
+	SpeciesOne imitative(*lowerRng, scratch);
 	imitative.writeImitativeTwoVoices(phraseLength * beatsPerMeasure / 2);
 	lowerVoiceI = imitative.getImitativeLower();
 	for (auto i : lowerVoiceI) {
@@ -314,52 +390,94 @@ void WritePhrase::writeUpperVoiceTwo() {
 	}
 	phraseN.addNoteToUpperVoice(convertIntToNoteTwo(upperVoiceI.at(upperVoiceI.size() - 4)));
 	phraseN.addNoteToUpperVoice(convertIntToNoteTwo(upperVoiceI.at(upperVoiceI.size() - 3)));
+}
 
-	// This idea is close to working but it's not so I'm going to try something else
-	/*if (rand() % 2 == 1) {
-		upperVoiceI.push_back(5);
+void WritePhrase::writeUpperVoiceThree() {
+	// A whole note lower voice, one note per four beats, with four quarter notes above each of its notes but the last
+	chooseLowerVoice(phraseLength * beatsPerMeasure / 4);
+	for (auto i : lowerVoiceI) {
+		Note note = convertIntToNote(i);
+		note.setLength(1);
+		phraseN.addNoteToLowerVoice(note);
 	}
-	else {
-		upperVoiceI.push_back(8);
+
+	SpeciesThree three(lowerVoiceI, scratch);
+	three.write(*upperRng, upperVoiceI);
+	for (size_t i = 0; i + 1 < upperVoiceI.size(); i++) {
+		phraseN.addNoteToUpperVoice(convertIntToNote(upperVoiceI[i]));
+	}
+	Note last = convertIntToNote(upperVoiceI.back());
+	last.setLength(1);
+	phraseN.addNoteToUpperVoice(last);
+}
+
+void WritePhrase::writeUpperVoiceFour() {
+	// A half note lower voice as in species 2, with two quarter notes above each of its notes but the last
+	chooseLowerVoice(phraseLength * beatsPerMeasure / 2);
+	for (auto i : lowerVoiceI) {
+		phraseN.addNoteToLowerVoice(convertIntToNoteTwo(i));
 	}
-	for (int i = 1; i < lowerVoiceI.size() - 1; i++) {
-		SpeciesOne one;
-		one.setNoteBefore(upperVoiceI.at(i - 1));
-		one.setNoteBelow(lowerVoiceI.at(i));
-		one.setNoteBeforeAndBelow(lowerVoiceI.at(i - 1));
-		if (i >= 2) {
-			one.setNoteTwoBefore(upperVoiceI.at(i - 2));
-		}
-		int nextNote = one.chooseNextNote();
-		upperVoiceI.push_back(nextNote);
+
+	pmr::vector<uint8_t> tied(scratch);
+	SpeciesFour four(lowerVoiceI, scratch);
+	four.write(*upperRng, upperVoiceI, tied);
+	for (size_t i = 0; i + 1 < upperVoiceI.size(); i++) {
+		Note note = convertIntToNote(upperVoiceI[i]);
+		note.setTied(tied[i]);
+		phraseN.addNoteToUpperVoice(note);
+	}
+	phraseN.addNoteToUpperVoice(convertIntToNoteTwo(upperVoiceI.back()));
+}
+
+void WritePhrase::writeUpperVoiceFive() {
+	// The whole note lower voice of species 3, with a measure of mixed rhythm above each of its notes but the last
+	chooseLowerVoice(phraseLength * beatsPerMeasure / 4);
+	for (auto i : lowerVoiceI) {
+		Note note = convertIntToNote(i);
+		note.setLength(1);
+		phraseN.addNoteToLowerVoice(note);
 	}
-	upperVoiceI.push_back(8);
 
-	// Now adds notes between the notes there.
-	
-	vector<int> toInsert;	// holds notes to be added
-	for (int i = 1; i < lowerVoiceI.size() - 2; i++) {
-		SpeciesTwo two;
-		two.setNoteBefore(upperVoiceI.at(i));
-		if (i >= 2) {
-			two.setNoteTwoBefore(upperVoiceI.at(i - 1));
-		}
-		toInsert.push_back(two.chooseNextNote());
+	pmr::vector<uint8_t> eighths(scratch);
+	pmr::vector<uint8_t> tied(scratch);
+	SpeciesFive five(lowerVoiceI, scratch);
+	five.write(*upperRng, upperVoiceI, eighths, tied);
+	for (size_t i = 0; i < upperVoiceI.size(); i++) {
+		Note note = convertIntToNote(upperVoiceI[i]);
+		note.setEighths(eighths[i]);
+		note.setTied(tied[i]);
+		phraseN.addNoteToUpperVoice(note);
 	}
-	for (int i = 0; i < toInsert.size(); i++) {
-		upperVoiceI.insert((upperVoiceI.begin() + (i * 2) + 1), toInsert.at(i));
+}
+
+void WritePhrase::writeVoices() {
+	// A cantus firmus an octave down is the bass. The random walk leaps into the cadence more often than the voices
+	// above it can follow
+	chooseCantus(phraseLength * beatsPerMeasure);
+	for (int& note : lowerVoiceI) {
+		note -= 7;
 	}
-	upperVoiceI.insert(upperVoiceI.end()-1,7);
 
-	for (int i = 0; i < upperVoiceI.size() - 1; i++) {
-		phraseN.addNoteToUpperVoice(convertIntToNote(i));
+	SpeciesOneVoices voices(lowerVoiceI, voiceCount, scratch);
+	voices.write(*upperRng);
+	int length = static_cast<int>(lowerVoiceI.size());
+	middleVoicesI.reserve((voiceCount - 2) * length);
+	for (int voice = 0; voice < voiceCount - 1; voice++) {
+		for (int i = 0; i < length; i++) {
+			int note = voices.noteAt(voice, i);
+			if (voice == 0) upperVoiceI.push_back(note);
+			else middleVoicesI.push_back(note);
+			phraseN.addNoteToVoice(voice, convertIntToNote(note));
+		}
+	}
+	for (auto i : lowerVoiceI) {
+		phraseN.addNoteToLowerVoice(convertIntToNote(i));
 	}
-	phraseN.addNoteToUpperVoice(convertIntToNoteTwo(upperVoiceI.at(upperVoiceI.size()-1)));*/
-	
 }
+
 		// Not being used right now. Code copied to writeUpperVoiceTwo()
 void WritePhrase::writeLowerVoiceTwo() {
-	SpeciesOne imitativeLower;
+	SpeciesOne imitativeLower(*lowerRng, scratch);
 	imitativeLower.writeImitativeTwoVoices(phraseLength * beatsPerMeasure / 2 );
 	lowerVoiceI = imitativeLower.getImitativeLower();
 	for (auto i : lowerVoiceI) {
@@ -1,20 +1,74 @@
 #pragma once
+#include "BeamSearch.h"
+#include "CantusFirmusLibrary.h"
+#include "MusicTables.h"
 #include "Note.h"
 #include "Phrase.h"
+#include "xorshift32.h"
+#include <cstdint>
+#include <memory_resource>
+#include <utility>
 #include <vector>
 using namespace std;
 
 // TODO: Complete this class
 
+// How writeUpperVoiceOne picks first species notes. The first three write the same phrase for the same draws
+enum SpeciesOneEngine {
+	Engine_Rules,		// SpeciesOne, running every rule for every note
+	Engine_Table,		// SpeciesOneTable, one lookup per note in a table built from the same rules
+	Engine_Composed,	// SpeciesKernel<FirstSpeciesRules>, the same rules composed at compile time
+	Engine_Uniform,		// SpeciesOneUniform, every upper voice the rules allow equally likely
+	Engine_Beam			// BeamSearch, the best scoring of many voices. Also writes the imitative (species 0) lower voice
+};
+
+// Names as used on the command line (rules, table, composed, uniform, beam), parseEngine throws runtime_error for others
+string engineName(SpeciesOneEngine engine);
+SpeciesOneEngine parseEngine(const string& name);
+
+// Where the lower voice of every species but the imitative one and derived second species comes from
+enum LowerVoiceSource {
+	Lower_Walk,			// GenerateLowerVoice's random walk
+	Lower_Cantus		// A CantusFirmus, or one picked from a CantusFirmusLibrary that has the phrase's length
+};
+
+// Names as used on the command line (walk, cantus), parseLowerVoice throws runtime_error for others
+string lowerVoiceName(LowerVoiceSource source);
+LowerVoiceSource parseLowerVoice(const string& name);
+
+// How the second species upper voice is written
+enum SpeciesTwoEngine {
+	Two_Rules,			// SpeciesTwo over a lower voice from the lower voice source
+	Two_Derived			// The imitative lower voice, with the upper voice a step above each of its notes as before
+};
+
+// Names as used on the command line (rules, derived), parseSpeciesTwo throws runtime_error for others
+string speciesTwoName(SpeciesTwoEngine engine);
+SpeciesTwoEngine parseSpeciesTwo(const string& name);
+
+// Throws runtime_error for a meter the species isn't written in. Third species puts four quarter notes over each whole
+// note of the lower voice and fifth species' rhythms fill four beats, so both need 4 beats to the measure
+void checkMeter(int speciesType, int beatsPerMeasure);
+
+// Dead ends met by the first species search, see WritePhrase::setBacktracking()
+struct BacktrackStats {
+	uint64_t backtracks = 0;	// Notes undone because a later note had no options left
+	uint64_t failures = 0;		// Phrases given up on, over the step budget or undoing too far
+};
+
 class WritePhrase {
 public:
-	WritePhrase(string key, int phraseLength);
+	// Scratch memory for generation (the integer voices and the engines' working vectors) comes from scratch,
+	// pass an Arena to keep the global allocator out of it. It must outlive this WritePhrase
+	WritePhrase(string key, int phraseLength, Xorshift32& rng, pmr::memory_resource* scratch = pmr::get_default_resource());
 	// Overloaded constructor
-	WritePhrase(string key, int phraseLength, int speciesType, int beatsPerMeasure);
+	WritePhrase(string key, int phraseLength, int speciesType, int beatsPerMeasure, Xorshift32& rng, pmr::memory_resource* scratch = pmr::get_default_resource());
 	// // Default constructor
 	// WritePhrase() = default;
 
-	static void setSeed(int seed);
+	// Both voices draw from the constructor's stream unless given their own (e.g. from Xorshift32::forVoice,
+	// or Xorshift32::counterBased for random access by note position)
+	void setVoiceRngs(Xorshift32& lowerRng, Xorshift32& upperRng) { this->lowerRng = &lowerRng; this->upperRng = &upperRng; }
 	int getPhraseLength() const { return phraseLength; }
 	int getBeatsPerMeasure() const { return beatsPerMeasure; }
 	int getSpeciesType() const { return speciesType; }
@@ -23,7 +77,33 @@ public:
 	void setLength(int length) { phraseLength = length; }
 	void setBeatsPerMeasure(int beatsPerMeasure) { this->beatsPerMeasure = beatsPerMeasure; }
 	void setSpeciesType(int speciesType) { this->speciesType = speciesType; }
-	Phrase getPhrase();
+	void setEngine(SpeciesOneEngine engine) { this->engine = engine; }
+	// Beam width, time budget and threads for Engine_Beam
+	void setBeamOptions(const BeamOptions& beamOptions) { this->beamOptions = beamOptions; }
+	// The library isn't owned and must outlive writeThePhrase(), without one every cantus firmus is generated
+	void setLowerVoice(LowerVoiceSource source, const CantusFirmusLibrary* library = nullptr) { lowerVoice = source; cantusLibrary = library; }
+	void setSpeciesTwo(SpeciesTwoEngine speciesTwo) { this->speciesTwo = speciesTwo; }
+	// Voices counting the lower one, 2 to SpeciesOneVoices::MAX_VOICES. More than two are only written in first
+	// species, by SpeciesOneVoices over a cantus firmus bass, and writeThePhrase() throws runtime_error otherwise
+	void setVoiceCount(int voiceCount) { this->voiceCount = voiceCount; }
+	int getVoiceCount() const { return voiceCount; }
+	// When the rules leave no note to choose, the first species search undoes notes and tries others, re-drawing
+	// deterministically (the next draws in stream mode, the next draw indexes of the note's position in counter
+	// mode). It gives up with a runtime_error after undoing more than stepBudget notes in all, or when a dead end
+	// would undo more than maxDepth notes behind the furthest note written
+	void setBacktracking(int maxDepth, int stepBudget) { this->maxDepth = maxDepth; this->stepBudget = stepBudget; }
+	BacktrackStats getBacktrackStats() const { return backtrackStats; }
+	// Totals over every WritePhrase in the process, safe to read from any thread
+	static BacktrackStats getTotalBacktrackStats();
+	// Sets the phrase's key and time signature, then returns it without copying
+	const Phrase& getPhrase();
+	// Same, but moves the phrase out (e.g. straight into ExportToFile::addPhrase), leaving this one empty
+	Phrase takePhrase() { getPhrase(); return move(phraseN); }
+	// Scale degrees behind the notes, filled by writeThePhrase()
+	const pmr::vector<int>& getUpperVoiceI() const { return upperVoiceI; }
+	const pmr::vector<int>& getLowerVoiceI() const { return lowerVoiceI; }
+	// Inner voices, one row as long as the lower voice per voice, top first. Empty for two voices
+	const pmr::vector<int>& getMiddleVoicesI() const { return middleVoicesI; }
 
 	void writeThePhrase();
 	void printPhraseI();
@@ -34,25 +114,47 @@ public:
 	string getTimeSignature();
 
 	// These four go together
-	Note* convertIntToNote(int num);
-	Note* convertIntToNoteTwo(int num);		// Only difference is it returns half notes instead of quarter notes
+	Note convertIntToNote(int num);
+	Note convertIntToNoteTwo(int num);		// Only difference is it returns half notes instead of quarter notes
 	int convertScaleDegreeToHalfStep(int halfStep);
 	Note convertKeyToNote();
-	void setKey(string key) { this->key = key; }
+	// Throws runtime_error for an unknown key, as the constructors do
+	void setKey(string key) { this->key = parseKey(key); }
 
 private:
-	string key;
+	Key key;					// Parsed once, every note looks its tonic up in KEYS
 	int phraseLength;			// In measures (number of measures)
 	int beatsPerMeasure = 4;
-	int speciesType = 1;		// Will take a 1, 2, or 0. 0 is for imitative counterpoint, which is stored in SpeciesOne
+	int speciesType = 1;		// Will take a 1, 2, 3, 4, 5, or 0. 0 is for imitative counterpoint, which is stored in SpeciesOne
+	SpeciesOneEngine engine = Engine_Rules;
+	BeamOptions beamOptions;
+	LowerVoiceSource lowerVoice = Lower_Walk;
+	SpeciesTwoEngine speciesTwo = Two_Rules;
+	int voiceCount = 2;
+	const CantusFirmusLibrary* cantusLibrary = nullptr;
+	int maxDepth = 8;
+	int stepBudget = 1000;
+	BacktrackStats backtrackStats;
+	Xorshift32* lowerRng;		// Not owned, must outlive writeThePhrase()
+	Xorshift32* upperRng;
+	pmr::memory_resource* scratch;
+	void chooseLowerVoice(int length);	// Fills lowerVoiceI from the lower voice source, without writing notes
+	void chooseCantus(int length);		// Same, always from a cantus firmus
 	void writeLowerVoice();
 	void writeUpperVoiceOne();
+	template <class Engine>
+	void writeUpperVoiceOneWith(Engine& engine);
 	void writeUpperVoiceTwo();
 	void writeLowerVoiceTwo();
+	void writeUpperVoiceThree();
+	void writeUpperVoiceFour();
+	void writeUpperVoiceFive();
+	void writeVoices();
 
 	Phrase phraseN;
-	vector<int> upperVoiceI;
-	vector<int> lowerVoiceI;
+	pmr::vector<int> upperVoiceI;
+	pmr::vector<int> lowerVoiceI;
+	pmr::vector<int> middleVoicesI;
 	
 	vector<string> intervalStrings;
 };
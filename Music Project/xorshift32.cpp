@@ -1,3 +1,82 @@
 #include "xorshift32.h"
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
 
-uint32_t Xorshift32::state = 0;
+uint32_t Xorshift32::deriveSeed(uint32_t seed, uint32_t stream) {
+	// Murmur3 finalizer over the parent seed and a golden-ratio spaced stream index
+	uint32_t h = seed ^ ((stream + 1) * 0x9E3779B9u);
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	// A zero state would make the generator return zero forever
+	return h != 0 ? h : 0x6D2B79F5u;
+}
+
+Xorshift32 Xorshift32::counterBased(uint32_t seed, uint32_t phraseIndex, uint32_t voice) {
+	Xorshift32 rng(voiceSeed(seed, phraseIndex, voice));
+	rng.counterMode = true;
+	return rng;
+}
+
+Xorshift32 Xorshift32::fromLane(Xorshift32Lanes& lanes, int lane) {
+	Xorshift32 rng;
+	rng.lanes = &lanes;
+	rng.lane = lane;
+	return rng;
+}
+
+Xorshift32Lanes::Xorshift32Lanes(const std::vector<uint32_t>& seeds, int blockSize) : queues(seeds.size()), blockSize(blockSize) {
+	states = seeds;
+	states.resize((seeds.size() + 7) / 8 * 8, 1);
+	block.resize(states.size());
+}
+
+void Xorshift32Lanes::refill() {
+	// Drop draws that have been read so a lane that keeps up never grows its queue
+	for (auto& q : queues) {
+		q.draws.erase(q.draws.begin(), q.draws.begin() + q.read);
+		q.read = 0;
+	}
+	for (int i = 0; i < blockSize; i++) {
+		stepAll(states.data(), block.data(), static_cast<int>(states.size()));
+		for (std::size_t lane = 0; lane < queues.size(); lane++) {
+			queues[lane].draws.push_back(block[lane]);
+		}
+	}
+}
+
+void Xorshift32Lanes::stepAll(uint32_t* states, uint32_t* outputs, int count) {
+	int i = 0;
+	// mullo keeps the low 32 bits of each product, the same wraparound as Math.imul in the TS port
+#if defined(__AVX2__)
+	const __m256i one = _mm256_set1_epi32(1);
+	const __m256i sixtyOne = _mm256_set1_epi32(61);
+	for (; i + 8 <= count; i += 8) {
+		__m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + i));
+		s = _mm256_mullo_epi32(_mm256_xor_si256(s, _mm256_srli_epi32(s, 15)), _mm256_or_si256(s, one));
+		__m256i t = _mm256_mullo_epi32(_mm256_xor_si256(s, _mm256_srli_epi32(s, 7)), _mm256_or_si256(s, sixtyOne));
+		s = _mm256_xor_si256(s, _mm256_add_epi32(s, t));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(states + i), s);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(outputs + i), _mm256_xor_si256(s, _mm256_srli_epi32(s, 14)));
+	}
+#elif defined(__SSE4_1__)
+	const __m128i one = _mm_set1_epi32(1);
+	const __m128i sixtyOne = _mm_set1_epi32(61);
+	for (; i + 4 <= count; i += 4) {
+		__m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(states + i));
+		s = _mm_mullo_epi32(_mm_xor_si128(s, _mm_srli_epi32(s, 15)), _mm_or_si128(s, one));
+		__m128i t = _mm_mullo_epi32(_mm_xor_si128(s, _mm_srli_epi32(s, 7)), _mm_or_si128(s, sixtyOne));
+		s = _mm_xor_si128(s, _mm_add_epi32(s, t));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(states + i), s);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(outputs + i), _mm_xor_si128(s, _mm_srli_epi32(s, 14)));
+	}
+#endif
+	// Scalar fallback, and the tail when count isn't a multiple of the vector width
+	for (; i < count; i++) {
+		states[i] = Xorshift32::step(states[i]);
+		outputs[i] = Xorshift32::output(states[i]);
+	}
+}
@@ -1,22 +1,102 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <vector>
 
+class Xorshift32Lanes;
+
+// Each generator owns its own state, so phrases written on different threads never share a stream.
+// Pass the same generator to every phrase to reproduce the old single-stream output for a seed.
+//
+// A generator made with counterBased() keeps no running state: each draw is a pure function of
+// (seed, phrase, voice, position, draw index), so any note's draws can be reproduced without replaying
+// the ones before it. Engines call setPosition() before the draws for each note; stream generators ignore it.
 class Xorshift32 {
-	static uint32_t state;
 public:
-	static void seed(uint32_t s) { state = s; }
-	static double nextFloat() {
+	explicit Xorshift32(uint32_t s = 0) : state(s) {}
+	static Xorshift32 counterBased(uint32_t seed, uint32_t phraseIndex, uint32_t voice);
+	static Xorshift32 fromLane(Xorshift32Lanes& lanes, int lane);
+	void seed(uint32_t s) { state = s; }
+	uint32_t getState() const { return state; }
+	bool isCounterBased() const { return counterMode; }
+	void setPosition(uint32_t position) { this->position = position; draw = 0; }
+	// Starts at a later draw of the position, so retrying a note in counter mode doesn't repeat the draws it used
+	void setPosition(uint32_t position, uint32_t draw) { this->position = position; this->draw = draw; }
+	double nextFloat() {
 		// Matches the TS implementation in WritePhrase.setSeed():
 		//   s = Math.imul(s ^ s >>> 15, s | 1);
 		//   s ^= s + Math.imul(s ^ s >>> 7, s | 61);
 		//   return ((s ^ s >>> 14) >>> 0) / 4294967296;
-		uint32_t s = state;
-		s = (s ^ (s >> 15)) * (s | 1);
-		s ^= s + ((s ^ (s >> 7)) * (s | 61));
-		state = s;
-		return ((s ^ (s >> 14))) / 4294967296.0;
+		if (lanes) return laneFloat();
+		uint32_t s = counterMode ? counterState() : state;
+		s = step(s);
+		if (!counterMode) state = s;
+		return output(s) / 4294967296.0;
 	}
-	static int nextInt(int max) {
+	int nextInt(int max) {
 		return static_cast<int>(nextFloat() * max);
 	}
+
+	// Seed splitting -- child seeds only depend on the parent seed and the index, never on how many draws were made
+	static uint32_t deriveSeed(uint32_t seed, uint32_t stream);
+	static uint32_t phraseSeed(uint32_t seed, uint32_t phraseIndex) { return deriveSeed(seed, phraseIndex); }
+	static uint32_t voiceSeed(uint32_t seed, uint32_t phraseIndex, uint32_t voice) { return deriveSeed(phraseSeed(seed, phraseIndex), voice); }
+	static Xorshift32 forPhrase(uint32_t seed, uint32_t phraseIndex) { return Xorshift32(phraseSeed(seed, phraseIndex)); }
+	static Xorshift32 forVoice(uint32_t seed, uint32_t phraseIndex, uint32_t voice) { return Xorshift32(voiceSeed(seed, phraseIndex, voice)); }
+
+	// Pure function behind counter mode, usable directly to check a single draw
+	static uint32_t counterSeed(uint32_t voiceKey, uint32_t position, uint32_t draw) { return deriveSeed(deriveSeed(voiceKey, position), draw); }
+
+	// One step of the generator, shared with the vectorized lanes in Xorshift32Lanes
+	static uint32_t step(uint32_t s) {
+		s = (s ^ (s >> 15)) * (s | 1);
+		return s ^ (s + ((s ^ (s >> 7)) * (s | 61)));
+	}
+	static uint32_t output(uint32_t s) { return s ^ (s >> 14); }
+
+private:
+	uint32_t state;
+
+	// Counter mode, state then holds voiceSeed(seed, phrase, voice)
+	bool counterMode = false;
+	uint32_t position = 0;
+	uint32_t draw = 0;
+	uint32_t counterState() { return counterSeed(state, position, draw++); }
+
+	// Lane mode, draws come from one lane of a shared Xorshift32Lanes
+	Xorshift32Lanes* lanes = nullptr;
+	int lane = 0;
+	double laneFloat();
+};
+
+// Many independent stream generators advanced together, several lanes per instruction (AVX2 or SSE4.1 when
+// the compiler targets them, plain loop otherwise). Lane i yields exactly the draws Xorshift32(seeds[i]) would,
+// so a batch of phrases can share one of these through Xorshift32::fromLane without changing its output.
+// Draws are made a block at a time for every lane; a lane that is read less often just keeps its draws queued.
+class Xorshift32Lanes {
+public:
+	explicit Xorshift32Lanes(const std::vector<uint32_t>& seeds, int blockSize = 64);
+	int size() const { return static_cast<int>(queues.size()); }
+	uint32_t nextOutput(int lane) {
+		Queue& q = queues[lane];
+		if (q.read == q.draws.size()) refill();
+		return q.draws[q.read++];
+	}
+	double nextFloat(int lane) { return nextOutput(lane) / 4294967296.0; }
+
+	// Advances count states by one step and writes their outputs, the vectorized kernel behind refill()
+	static void stepAll(uint32_t* states, uint32_t* outputs, int count);
+
+private:
+	struct Queue {
+		std::vector<uint32_t> draws;
+		size_t read = 0;
+	};
+	std::vector<uint32_t> states;	// Padded to a whole number of vector widths
+	std::vector<uint32_t> block;	// Outputs of one step, indexed by lane
+	std::vector<Queue> queues;
+	int blockSize;
+	void refill();
 };
+
+inline double Xorshift32::laneFloat() { return lanes->nextFloat(lane); }
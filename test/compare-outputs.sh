@@ -38,6 +38,14 @@ make -C "$CPP_DIR" > /dev/null 2>&1
 echo "C++ build complete."
 echo ""
 
+# Generate every C++ case in one process, one file per job
+CPP_BATCH_DIR="$TMP_DIR/cpp_batch"
+rm -rf "$CPP_BATCH_DIR"
+mkdir -p "$CPP_BATCH_DIR"
+"$CPP_DIR/counterpoint" --batch \
+    --seeds "$SEED" --keys "$(IFS=,; echo "${KEYS[*]}")" --species "$(IFS=,; echo "${CPP_SPECIES[*]}")" \
+    --measures 4 --beats 4 --species-two derived --output-dir "$CPP_BATCH_DIR" > /dev/null
+
 for si in 0 1 2; do
     cpp_sp="${CPP_SPECIES[$si]}"
     ts_sp="${TS_SPECIES[$si]}"
@@ -47,14 +55,10 @@ for si in 0 1 2; do
         TOTAL=$((TOTAL + 1))
         label="$sp_name / Key=$key"
 
-        cpp_out="$TMP_DIR/cpp_${sp_name}_${key}.txt"
+        # Batch files are named INDEX_SEED_KEY_SPECIES_MEASURES_BEATS.txt
+        cpp_out=$(ls "$CPP_BATCH_DIR"/*_"${SEED}_${key}_${cpp_sp}"_4_4.txt 2>/dev/null || true)
         ts_out="$TMP_DIR/ts_${sp_name}_${key}.txt"
 
-        # Run C++
-        "$CPP_DIR/counterpoint" \
-            --seed "$SEED" --key "$key" --species "$cpp_sp" \
-            --measures 4 --beats 4 --output "$cpp_out" 2>/dev/null
-
         # Run TS
         bun run "$PROJECT_DIR/src/compare-runner.ts" \
             --seed "$SEED" --key "$key" --species "$ts_sp" \
@@ -88,6 +92,26 @@ for si in 0 1 2; do
     done
 done
 
+# Spec files: a # inside a value (F#, a title) is not a comment
+TOTAL=$((TOTAL + 1))
+spec_file="$TMP_DIR/sharp_spec.txt"
+spec_out="$TMP_DIR/sharp_spec_out.txt"
+cat > "$spec_file" <<EOF
+# Comment line
+title = Etude in F#    # trailing comment
+output = $spec_out
+overwrite = true
+phrase key=F# species=1 measures=2 beats=4 seed=3
+EOF
+"$CPP_DIR/counterpoint" --spec "$spec_file" > /dev/null
+if grep -q 'key fis \\major' "$spec_out" && grep -q 'Etude in F#"' "$spec_out"; then
+    echo "  PASS: Spec / Key=F#"
+    PASS=$((PASS + 1))
+else
+    echo "  FAIL: Spec / Key=F#"
+    FAIL=$((FAIL + 1))
+fi
+
 echo ""
 echo "=== Results ==="
 echo "Total: $TOTAL  Pass: $PASS  Fail: $FAIL"